@@ -1,11 +1,34 @@
+#pragma once
+
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define L_GEBRA_IMPLEMENTATION
 #include "../l_gebra/l_gebra.hpp"
 
+// Screen position of a world position, as the camera sees it:
+//   screen_x = xx * world_x + xy * world_y + x
+//   screen_y = yx * world_x + yy * world_y + y
+struct Camera_transform
+{
+  float xx, xy, yx, yy;
+  float x, y;
+};
+
+// Axis aligned rectangle of the world, in world units
+struct View_bounds
+{
+  float min_x, min_y;
+  float max_x, max_y;
+};
+
 class Camera2D
 {
   size_t _screen_width;
@@ -19,6 +42,11 @@ class Camera2D
   float _min_zoom;
   float _max_zoom;
 
+  // Derived from the members above by update_transform() whenever one of them changes
+  double _cos;
+  double _sin;
+  Camera_transform _transform;
+
   public:
   Camera2D(size_t screen_width, size_t screen_height)
       : _screen_width(screen_width),
@@ -31,6 +59,7 @@ class Camera2D
         _min_zoom(0.1f),
         _max_zoom(10.0f)
   {
+    update_transform();
   }
 
   Camera2D(size_t screen_width, size_t screen_height, utl::Vec<float, 2> position, float zoom, float rotation)
@@ -44,6 +73,7 @@ class Camera2D
         _min_zoom(0.1f),
         _max_zoom(10.0f)
   {
+    update_transform();
   }
 
   Camera2D(size_t screen_width, size_t screen_height, utl::Vec<float, 2> position)
@@ -57,6 +87,7 @@ class Camera2D
         _min_zoom(0.1f),
         _max_zoom(10.0f)
   {
+    update_transform();
   }
 
   Camera2D(size_t screen_width, size_t screen_height, float zoom)
@@ -70,6 +101,7 @@ class Camera2D
         _min_zoom(0.1f),
         _max_zoom(10.0f)
   {
+    update_transform();
   }
 
   Camera2D(const Camera2D &camera)
@@ -81,7 +113,10 @@ class Camera2D
         _world_min(camera._world_min),
         _world_max(camera._world_max),
         _min_zoom(camera._min_zoom),
-        _max_zoom(camera._max_zoom)
+        _max_zoom(camera._max_zoom),
+        _cos(camera._cos),
+        _sin(camera._sin),
+        _transform(camera._transform)
   {
   }
 
@@ -91,13 +126,21 @@ class Camera2D
     clamp_position();
   }
 
-  void set_zoom(float zoom) { _zoom = std::clamp(zoom, _min_zoom, _max_zoom); }
+  void set_zoom(float zoom)
+  {
+    _zoom = std::clamp(zoom, _min_zoom, _max_zoom);
+    update_transform();
+  }
 
   void zoom_by(float dz) { set_zoom(_zoom + dz); }
 
-  void set_rotation(float rotation) { _rotation = rotation; }
+  void set_rotation(float rotation)
+  {
+    _rotation = rotation;
+    update_transform();
+  }
 
-  void rotate_by(float dr) { _rotation += dr; }
+  void rotate_by(float dr) { set_rotation(_rotation + dr); }
 
   void panf(utl::Vec<float, 2> dp, float delta_time)
   {
@@ -135,6 +178,7 @@ class Camera2D
   {
     _screen_width = screen_width;
     _screen_height = screen_height;
+    update_transform();
   }
 
   void reset()
@@ -142,6 +186,7 @@ class Camera2D
     _position = {0, 0};
     _zoom = 1.0f;
     _rotation = 0.0f;
+    update_transform();
   }
 
   void follow(utl::Vec<float, 2> target_position, float delta_time, float follow_speed)
@@ -187,9 +232,109 @@ class Camera2D
   {
     int centerx = static_cast<int>(_screen_width / 2);
     int centery = static_cast<int>(_screen_height / 2);
-    int x = static_cast<int>((world_position[0] - _position[0]) * _zoom + centerx);
-    int y = static_cast<int>((world_position[1] - _position[1]) * _zoom + centery);
-    return utl::Vec<int, 2>{x, y}.rotate_about_center({centerx, centery}, _rotation, 'z');
+    int x = static_cast<int>((world_position[0] - _position[0]) * _zoom + centerx) - centerx;
+    int y = static_cast<int>((world_position[1] - _position[1]) * _zoom + centery) - centery;
+    return utl::Vec<int, 2>{static_cast<int>(x * _cos - y * _sin) + centerx, static_cast<int>(x * _sin + y * _cos) + centery};
+  }
+
+  // The combined world to screen transform, kept up to date with the position, zoom and rotation
+  const Camera_transform &get_transform() const { return _transform; }
+
+  // Transform `count` positions at once, without the intermediate rounding of world_to_screen
+  // so a position can land one cell away from it
+  // @param world_x, world_y The world positions
+  // @param screen_x, screen_y Receive the screen positions, truncated like world_to_screen
+  void world_to_screen(const float *world_x, const float *world_y, size_t count, int *screen_x, int *screen_y) const
+  {
+    const Camera_transform &t = _transform;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 xx = _mm_set1_ps(t.xx), xy = _mm_set1_ps(t.xy), yx = _mm_set1_ps(t.yx), yy = _mm_set1_ps(t.yy);
+    const __m128 ox = _mm_set1_ps(t.x), oy = _mm_set1_ps(t.y);
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128 wx = _mm_loadu_ps(world_x + i), wy = _mm_loadu_ps(world_y + i);
+      __m128 sx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, wx), _mm_mul_ps(xy, wy)), ox);
+      __m128 sy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(yx, wx), _mm_mul_ps(yy, wy)), oy);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(screen_x + i), _mm_cvttps_epi32(sx));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(screen_y + i), _mm_cvttps_epi32(sy));
+    }
+#endif
+    for (; i < count; i++)
+    {
+      screen_x[i] = static_cast<int>(t.xx * world_x[i] + t.xy * world_y[i] + t.x);
+      screen_y[i] = static_cast<int>(t.yx * world_x[i] + t.yy * world_y[i] + t.y);
+    }
+  }
+
+  // Whether a world position lands on the screen
+  // @param margin Extra cells around the screen, e.g. the radius of the entity in cells
+  bool is_visible(utl::Vec<float, 2> world_position, float margin = 0.0f) const
+  {
+    const Camera_transform &t = _transform;
+    float sx = t.xx * world_position[0] + t.xy * world_position[1] + t.x;
+    float sy = t.yx * world_position[0] + t.yy * world_position[1] + t.y;
+    return sx >= -margin && sx < _screen_width + margin && sy >= -margin && sy < _screen_height + margin;
+  }
+
+  // Find the positions that land on the screen, so off screen entities are skipped before drawing
+  // @param world_x, world_y The world positions
+  // @param margin Extra cells around the screen, e.g. the radius of the entities in cells
+  // @param visible Receives the indices of the visible positions, in order, room for `count` of them
+  // @return The number of visible positions
+  size_t cull(const float *world_x, const float *world_y, size_t count, float margin, uint32_t *visible) const
+  {
+    const Camera_transform &t = _transform;
+    const float min_x = -margin, min_y = -margin;
+    const float max_x = _screen_width + margin, max_y = _screen_height + margin;
+    size_t n = 0, i = 0;
+#if defined(__SSE2__)
+    const __m128 xx = _mm_set1_ps(t.xx), xy = _mm_set1_ps(t.xy), yx = _mm_set1_ps(t.yx), yy = _mm_set1_ps(t.yy);
+    const __m128 ox = _mm_set1_ps(t.x), oy = _mm_set1_ps(t.y);
+    const __m128 lo_x = _mm_set1_ps(min_x), lo_y = _mm_set1_ps(min_y), hi_x = _mm_set1_ps(max_x), hi_y = _mm_set1_ps(max_y);
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128 wx = _mm_loadu_ps(world_x + i), wy = _mm_loadu_ps(world_y + i);
+      __m128 sx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, wx), _mm_mul_ps(xy, wy)), ox);
+      __m128 sy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(yx, wx), _mm_mul_ps(yy, wy)), oy);
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(sx, lo_x), _mm_cmplt_ps(sx, hi_x)),
+                                 _mm_and_ps(_mm_cmpge_ps(sy, lo_y), _mm_cmplt_ps(sy, hi_y)));
+      int mask = _mm_movemask_ps(inside);
+      for (; mask; mask &= mask - 1) visible[n++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+    }
+#endif
+    for (; i < count; i++)
+    {
+      float sx = t.xx * world_x[i] + t.xy * world_y[i] + t.x;
+      float sy = t.yx * world_x[i] + t.yy * world_y[i] + t.y;
+      if (sx >= min_x && sx < max_x && sy >= min_y && sy < max_y)
+        visible[n++] = static_cast<uint32_t>(i);
+    }
+    return n;
+  }
+
+  // The part of the world on screen, the bounding box of the rotated view
+  View_bounds get_view_bounds() const
+  {
+    // Corners of the screen back to the world, through the inverse of the transform
+    const Camera_transform &t = _transform;
+    float det = t.xx * t.yy - t.xy * t.yx;
+    View_bounds bounds{std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::lowest(),
+                       std::numeric_limits<float>::lowest()};
+    const float corners[4][2] = {{0, 0}, {(float)_screen_width, 0}, {0, (float)_screen_height}, {(float)_screen_width, (float)_screen_height}};
+    for (const auto &corner : corners)
+    {
+      float dx = corner[0] - t.x, dy = corner[1] - t.y;
+      float wx = (t.yy * dx - t.xy * dy) / det;
+      float wy = (t.xx * dy - t.yx * dx) / det;
+      bounds.min_x = std::min(bounds.min_x, wx);
+      bounds.min_y = std::min(bounds.min_y, wy);
+      bounds.max_x = std::max(bounds.max_x, wx);
+      bounds.max_y = std::max(bounds.max_y, wy);
+    }
+    return bounds;
   }
 
   utl::Vec<int, 2> world_to_screen_no_rotation(utl::Vec<float, 2> world_position) const
@@ -205,9 +350,13 @@ class Camera2D
   {
     int centerx = static_cast<int>(_screen_width / 2);
     int centery = static_cast<int>(_screen_height / 2);
-    utl::Vec<int, 2> result = screen_position.rotate_about_center({centerx, centery}, -_rotation, 'z');
-    int x = static_cast<int>((result[0] - centerx) / _zoom + _position[0]);
-    int y = static_cast<int>((result[1] - centery) / _zoom + _position[1]);
+    // Rotate back by -rotation, sin(-r) = -sin(r)
+    int dx = screen_position[0] - centerx;
+    int dy = screen_position[1] - centery;
+    int rx = static_cast<int>(dx * _cos + dy * _sin);
+    int ry = static_cast<int>(dy * _cos - dx * _sin);
+    int x = static_cast<int>(rx / _zoom + _position[0]);
+    int y = static_cast<int>(ry / _zoom + _position[1]);
     return utl::Vec<int, 2>{x, y};
   }
 
@@ -225,5 +374,21 @@ class Camera2D
   {
     _position[0] = std::clamp(_position[0], _world_min[0], _world_max[0]);
     _position[1] = std::clamp(_position[1], _world_min[1], _world_max[1]);
+    update_transform();
+  }
+
+  void update_transform()
+  {
+    _cos = std::cos(_rotation);
+    _sin = std::sin(_rotation);
+    // screen = R(rotation) * (world - position) * zoom + center
+    float c = static_cast<float>(_cos) * _zoom, s = static_cast<float>(_sin) * _zoom;
+    float centerx = static_cast<float>(_screen_width / 2), centery = static_cast<float>(_screen_height / 2);
+    _transform.xx = c;
+    _transform.xy = -s;
+    _transform.yx = s;
+    _transform.yy = c;
+    _transform.x = centerx - (c * _position[0] - s * _position[1]);
+    _transform.y = centery - (s * _position[0] + c * _position[1]);
   }
 };
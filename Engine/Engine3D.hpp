@@ -11,6 +11,7 @@
 #include "../l_gebra/l_gebra.hpp"
 #define RENDERER_IMPLEMENTATION
 #include "../renderer2D/ascii.hpp"
+#include "../time/profiler.hpp"
 
 /*!
   * Engine3D class is a simple 3D rendering engine that uses 3D triangles to render 3D objects.
@@ -110,6 +111,7 @@ public:
   */
   Triangle3D project_triangle(const Triangle3D &tri) const
   {
+    PROFILE_SCOPE("engine3d");
     Triangle3D projected_tri = tri;
     projected_tri.set_v1(get_projection(tri.get_v1()));
     projected_tri.set_v2(get_projection(tri.get_v2()));
@@ -179,6 +181,7 @@ public:
   */
   Triangle3D apply_view_transform(const Triangle3D &tri) const
   {
+    PROFILE_SCOPE("engine3d");
     Triangle3D result = tri;
     result.set_v1(apply_view_transform(tri.get_v1()));
     result.set_v2(apply_view_transform(tri.get_v2()));
@@ -243,6 +246,7 @@ public:
   */
   std::vector<Triangle3D> tri_clip_against_planes(const Triangle3D &triangle, std::vector<Plane> planes)
   {
+    PROFILE_SCOPE("engine3d");
     std::list<Triangle3D> listTriangles = {triangle};
 
     for (const auto &plane : planes)
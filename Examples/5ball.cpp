@@ -2,6 +2,7 @@
 #define RENDERER_IMPLEMENTATION
 #include "../Camera/camera2D.hpp"
 #include "../renderer2D/ascii.hpp"
+#include "../time/fixed_step.hpp"
 #include "../time/frame_rate.hpp"
 
 int main()
@@ -17,6 +18,8 @@ int main()
   const float circle_speed = 100.0f;            // Speed of the circle movement in units per second
   const float follow_speed = 30.0f;             // Adjust this to change how quickly the camera follows
   Frame_rate frame_rate(80);
+  Fixed_step simulation(1.0 / 120.0);
+  utl::Vec<float, 2> previous_position = circle_position;
 
   while (true)
   {
@@ -40,9 +43,16 @@ int main()
     if (Window::is_pressed(KEY_RIGHT))
       circle_velocity = circle_velocity + utl::Vec<int, 2>({(int)circle_speed, 0});
     //
-    float delta_time = frame_rate.get_delta_time();
-    // Update the circle position
-    circle_position = circle_position + (circle_velocity * delta_time);
+    float delta_time = frame_rate.get_frame_time();
+    // Step the circle at a fixed rate, independent of how long rendering took
+    simulation.update(frame_rate,
+                      [&](double dt)
+                      {
+                        previous_position = circle_position;
+                        circle_position = circle_position + (circle_velocity * (float)dt);
+                      });
+    float alpha = (float)simulation.alpha();
+    utl::Vec<float, 2> render_position = previous_position + (circle_position - previous_position) * alpha;
 
     std::string debug = "delta_time: " + std::to_string(delta_time) + " circle_velocity: " + std::to_string(circle_velocity[0]) + "," +
                         std::to_string(circle_velocity[1]);
@@ -56,10 +66,10 @@ int main()
       camera.zoom_by(-0.1f);
 
     // Make the camera follow the circle with a delay
-    camera.smooth_follow(circle_position, delta_time, 1);
+    camera.smooth_follow(render_position, delta_time, 1);
 
-    // Draw the circle at its world position
-    auto screen_position = camera.world_to_screen(circle_position);
+    // Draw the circle at its interpolated world position
+    auto screen_position = camera.world_to_screen(render_position);
     r.draw_fill_circle(screen_position, static_cast<int>(5 * camera.get_zoom()), 'x', utl::Color_codes::CYAN);
 
     // Display positions and frame rate
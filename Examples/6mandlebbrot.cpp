@@ -1,64 +1,41 @@
-#include <complex>
 #include <cstdlib>
 
 #define RENDERER_IMPLEMENTATION
 #include "../renderer2D/ascii.hpp"
 #include "../time/frame_rate.hpp"
 
+// Keeps the view of the explorer, the cells are computed by Escape_time_fractal
 class Mandelbrot
 {
   int _width, _height;
-  int _max_iterations;
-  float _zoom, _offsetX, _offsetY;
+  double _zoom, _offsetX, _offsetY;
+  Escape_time_fractal _fractal;
+  Gradient _gradient;
 
 public:
-  Mandelbrot(int width, int height, int max_iterations, float zoom = 1.0f, float offsetX = 0.0f, float offsetY = 0.0f)
-      : _width(width), _height(height), _max_iterations(max_iterations), _zoom(zoom), _offsetX(offsetX), _offsetY(offsetY)
+  Mandelbrot(int width, int height, int max_iterations, double zoom = 1.0, double offsetX = 0.0, double offsetY = 0.0)
+      : _width(width), _height(height), _zoom(zoom), _offsetX(offsetX), _offsetY(offsetY), _fractal(width, height, max_iterations)
   {
+    // Coloring based on iterations
+    _gradient.add_color_stop(0.0f, utl::Color_codes::DARK_BLUE);
+    _gradient.add_color_stop(0.5f, utl::Color_codes::BLUE);
+    _gradient.add_color_stop(1.0f, utl::Color_codes::LIGHT_BLUE);
   }
 
-  int compute(const std::complex<float> &c) const
+  void render(Renderer &r)
   {
-    std::complex<float> z = 0;
-    int n = 0;
-    while (abs(z) <= 2.0 && n < _max_iterations)
-    {
-      z = z * z + c;
-      n++;
-    }
-    return n;
+    // Panning keeps the cells still on screen, zooming starts again from a coarse pass, either
+    // way the cells left are refined over the next frames
+    _fractal.set_view(_offsetX, _offsetY, 4.0 / (_width * _zoom), 4.0 / (_height * _zoom));
+    _fractal.refine(50.0);
+    r.draw_fractal(_fractal, _gradient, '#');
   }
 
-  void render(Renderer &r) const
-  {
-    for (int y = 0; y < _height; y++)
-    {
-      for (int x = 0; x < _width; x++)
-      {
-        std::complex<float> c((x - _width / 2.0f) * 4.0f / (_width * _zoom) + _offsetX,
-                              (y - _height / 2.0f) * 4.0f / (_height * _zoom) + _offsetY);
-        int n = compute(c);
-        float t = (float)n / _max_iterations;
-
-        // Coloring based on iterations
-        Color color;
-        if (n == _max_iterations)
-          color = utl::Color_codes::BLACK;
-        else if (t < 0.5f)
-          color = Color::lerp(utl::Color_codes::DARK_BLUE, utl::Color_codes::BLUE, t * 2.0f);
-        else
-          color = Color::lerp(utl::Color_codes::BLUE, utl::Color_codes::LIGHT_BLUE, (t - 0.5f) * 2.0f);
-
-        r.draw_point({x, y}, '#', color);
-      }
-    }
-  }
-
-  void zoom_in() { _zoom *= 2.0f; }
+  void zoom_in() { _zoom *= 2.0; }
 
-  void zoom_out() { _zoom /= 2.0f; }
+  void zoom_out() { _zoom /= 2.0; }
 
-  void move(float dx, float dy)
+  void move(double dx, double dy)
   {
     _offsetX += dx / _zoom;
     _offsetY += dy / _zoom;
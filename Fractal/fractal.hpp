@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The few vector operations the escape time kernel needs, for floats and doubles, 8 and 4 lanes
+// wide with AVX, 4 and 2 with SSE2
+namespace fractal_lanes
+{
+#if defined(__AVX__)
+  struct Floats
+  {
+    using T = float;
+    using Vector = __m256;
+    static constexpr int count = 8;
+    static Vector set1(T v) { return _mm256_set1_ps(v); }
+    static Vector load(const T *p) { return _mm256_loadu_ps(p); }
+    static void store(T *p, Vector v) { _mm256_storeu_ps(p, v); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+    static Vector less(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Vector less_equal(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Vector and_(Vector a, Vector b) { return _mm256_and_ps(a, b); }
+    static Vector and_not(Vector a, Vector b) { return _mm256_andnot_ps(a, b); }
+    static Vector or_(Vector a, Vector b) { return _mm256_or_ps(a, b); }
+    static int mask(Vector v) { return _mm256_movemask_ps(v); }
+  };
+
+  struct Doubles
+  {
+    using T = double;
+    using Vector = __m256d;
+    static constexpr int count = 4;
+    static Vector set1(T v) { return _mm256_set1_pd(v); }
+    static Vector load(const T *p) { return _mm256_loadu_pd(p); }
+    static void store(T *p, Vector v) { _mm256_storeu_pd(p, v); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+    static Vector less(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Vector less_equal(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static Vector and_(Vector a, Vector b) { return _mm256_and_pd(a, b); }
+    static Vector and_not(Vector a, Vector b) { return _mm256_andnot_pd(a, b); }
+    static Vector or_(Vector a, Vector b) { return _mm256_or_pd(a, b); }
+    static int mask(Vector v) { return _mm256_movemask_pd(v); }
+  };
+#elif defined(__SSE2__)
+  struct Floats
+  {
+    using T = float;
+    using Vector = __m128;
+    static constexpr int count = 4;
+    static Vector set1(T v) { return _mm_set1_ps(v); }
+    static Vector load(const T *p) { return _mm_loadu_ps(p); }
+    static void store(T *p, Vector v) { _mm_storeu_ps(p, v); }
+    static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+    static Vector less(Vector a, Vector b) { return _mm_cmplt_ps(a, b); }
+    static Vector less_equal(Vector a, Vector b) { return _mm_cmple_ps(a, b); }
+    static Vector and_(Vector a, Vector b) { return _mm_and_ps(a, b); }
+    static Vector and_not(Vector a, Vector b) { return _mm_andnot_ps(a, b); }
+    static Vector or_(Vector a, Vector b) { return _mm_or_ps(a, b); }
+    static int mask(Vector v) { return _mm_movemask_ps(v); }
+  };
+
+  struct Doubles
+  {
+    using T = double;
+    using Vector = __m128d;
+    static constexpr int count = 2;
+    static Vector set1(T v) { return _mm_set1_pd(v); }
+    static Vector load(const T *p) { return _mm_loadu_pd(p); }
+    static void store(T *p, Vector v) { _mm_storeu_pd(p, v); }
+    static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+    static Vector less(Vector a, Vector b) { return _mm_cmplt_pd(a, b); }
+    static Vector less_equal(Vector a, Vector b) { return _mm_cmple_pd(a, b); }
+    static Vector and_(Vector a, Vector b) { return _mm_and_pd(a, b); }
+    static Vector and_not(Vector a, Vector b) { return _mm_andnot_pd(a, b); }
+    static Vector or_(Vector a, Vector b) { return _mm_or_pd(a, b); }
+    static int mask(Vector v) { return _mm_movemask_pd(v); }
+  };
+#endif
+}  // namespace fractal_lanes
+
+/*!
+ * \class Escape_time_fractal
+ *
+ * \brief Mandelbrot or Julia set computed into a grid of smooth iteration counts, one per cell,
+ * which Renderer::draw_fractal colors through the baked table of a Gradient.
+ *
+ * Cell (x, y) samples c = (center_x + (x - width / 2) * step_x, center_y + (y - height / 2) * step_y).
+ * Rows are computed by several lanes at once and handed out one at a time to the threads, so
+ * expensive rows (the ones crossing the set) don't pile up on one thread. The kernel runs in
+ * floats while the steps are large enough for them and in doubles when zoomed in further.
+ * For the Mandelbrot set, points in the main cardioid and the period 2 bulb are known to be
+ * inside and skip the iterations, and orbits that come back to where they were a power of two
+ * iterations ago are stopped as periodic, as they will never escape.
+ *
+ * Cells are kept between frames. A view moved by a whole number of cells shifts them and only
+ * the strips it exposes are computed again, any other change of view or parameters computes
+ * every cell again. refine() spreads that work over frames: it first computes one cell out of
+ * every 4 x 4 block and fills the block with it, then one out of every 2 x 2, then the rest,
+ * stopping when its time budget is spent and carrying on from there on the next call.
+ *
+ *   Escape_time_fractal fractal(w, h, 500);
+ *   fractal.set_view(-0.5, 0.0, 4.0 / w, 4.0 / h);
+ *   fractal.refine(30.0);
+ *   renderer.draw_fractal(fractal, gradient);
+ */
+class Escape_time_fractal
+{
+public:
+  static constexpr float inside = -1.0f;  //>> Value of the cells in the set
+  static constexpr double bailout = 256;  //>> |z|^2 an orbit escapes at, large so the smoothing is continuous
+
+private:
+  size_t _width;
+  size_t _height;
+  int _max_iterations;
+  unsigned _threads;              //>> Max threads of compute, 0 for one per core
+  double _center_x = 0.0;
+  double _center_y = 0.0;
+  double _step_x = 0.0;           //>> Distance between the samples of two cells
+  double _step_y = 0.0;
+  bool _julia = false;            //>> Julia set of c = (_julia_x, _julia_y) instead of the Mandelbrot set
+  double _julia_x = 0.0;
+  double _julia_y = 0.0;
+  std::vector<float> _values;     //>> Smooth iteration count per cell, inside for the cells in the set
+  std::vector<uint8_t> _exact;    //>> 1 for the cells computed for the current view, the others hold a neighbour's value
+  int _pass = 0;                  //>> Refinement pass in progress, index in pass_strides
+  size_t _next_row = 0;           //>> First row of the pass not refined yet
+  size_t _cells_computed = 0;     //>> Cells iterated so far
+
+public:
+  // Distance between the cells computed by every refinement pass, the first one is always completed
+  static constexpr size_t pass_strides[] = {4, 2, 1};
+  static constexpr int pass_count = 3;
+
+public:
+  // @param width, height Size of the grid in cells
+  // @param max_iterations Iterations after which a point is considered inside
+  // @param threads Max threads compute runs on, 0 for one per core
+  Escape_time_fractal(size_t width, size_t height, int max_iterations, unsigned threads = 0)
+      : _width(width),
+        _height(height),
+        _max_iterations(max_iterations),
+        _threads(threads),
+        _values(width * height, inside),
+        _exact(width * height, 0)
+  {
+    set_view(0.0, 0.0, 4.0 / width, 4.0 / height);
+  }
+
+  // Keeps the computed cells when the view only moved by a whole number of cells
+  // @param center_x, center_y The point of the plane at the center of the grid
+  // @param step_x, step_y Distance on the plane between two neighbour cells
+  void set_view(double center_x, double center_y, double step_x, double step_y)
+  {
+    const double shift_x = (center_x - _center_x) / _step_x, shift_y = (center_y - _center_y) / _step_y;
+    const bool same_steps = step_x == _step_x && step_y == _step_y;
+    _center_x = center_x;
+    _center_y = center_y;
+    _step_x = step_x;
+    _step_y = step_y;
+    if (same_steps && std::fabs(shift_x - std::round(shift_x)) < 1e-3 && std::fabs(shift_y - std::round(shift_y)) < 1e-3)
+      shift(static_cast<long>(std::round(shift_x)), static_cast<long>(std::round(shift_y)));
+    else
+      invalidate();
+  }
+
+  // Compute the Julia set of c = (x, y) instead
+  void set_julia(double x, double y)
+  {
+    if (!_julia || x != _julia_x || y != _julia_y)
+      invalidate();
+    _julia = true;
+    _julia_x = x;
+    _julia_y = y;
+  }
+
+  void set_mandelbrot()
+  {
+    if (_julia)
+      invalidate();
+    _julia = false;
+  }
+
+  void set_max_iterations(int max_iterations)
+  {
+    if (max_iterations != _max_iterations)
+      invalidate();
+    _max_iterations = max_iterations;
+  }
+
+  void set_threads(unsigned threads) { _threads = threads; }
+
+  void resize(size_t width, size_t height)
+  {
+    _width = width;
+    _height = height;
+    _values.assign(width * height, inside);
+    _exact.assign(width * height, 0);
+    invalidate();
+  }
+
+  // Compute every cell again on the next refine or compute
+  void invalidate()
+  {
+    std::fill(_exact.begin(), _exact.end(), 0);
+    _pass = 0;
+    _next_row = 0;
+  }
+
+  // Compute every cell not computed yet for the current view
+  void compute() { refine(std::numeric_limits<double>::infinity()); }
+
+  // Carry on computing the cells for up to `budget_ms` milliseconds, the coarse first pass is
+  // always completed so no cell is left from an older view
+  // @return True when every cell is computed
+  bool refine(double budget_ms)
+  {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline =
+        budget_ms >= 1e9 ? Clock::time_point::max() : Clock::now() + std::chrono::microseconds(static_cast<long long>(budget_ms * 1000.0));
+    for (; _pass < pass_count; _pass++, _next_row = 0)
+    {
+      const size_t stride = pass_strides[_pass];
+      _next_row = refine_rows(stride, _pass == 0 ? Clock::time_point::max() : deadline);
+      if (_next_row < _height)
+        return false;
+    }
+    return true;
+  }
+
+  // Whether every cell is computed for the current view
+  bool is_complete() const { return _pass >= pass_count; }
+
+  // Whether the kernel runs in doubles for the current view, floats can't tell neighbour cells apart
+  bool uses_doubles() const
+  {
+    double magnitude = std::max({1.0, std::fabs(_center_x), std::fabs(_center_y)});
+    return std::min(_step_x, _step_y) < magnitude * 1e-5;
+  }
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  int max_iterations() const { return _max_iterations; }
+  double center_x() const { return _center_x; }
+  double center_y() const { return _center_y; }
+  double step_x() const { return _step_x; }
+  double step_y() const { return _step_y; }
+
+  // Smooth iteration count of cell (x, y), `inside` for the cells in the set
+  float value(size_t x, size_t y) const { return _values[y * _width + x]; }
+  const float *values() const { return _values.data(); }
+
+  // Cells iterated since the fractal was made, to see how much panning and refining save
+  size_t cells_computed() const { return _cells_computed; }
+
+private:
+  // Move the cells by (dx, dy), cell (x, y) takes the value of cell (x + dx, y + dy)
+  void shift(long dx, long dy)
+  {
+    if (dx == 0 && dy == 0)
+      return;
+    std::vector<float> values(_values.size(), inside);
+    std::vector<uint8_t> exact(_exact.size(), 0);
+    for (long y = 0; y < (long)_height; y++)
+    {
+      long from_y = y + dy;
+      if (from_y < 0 || from_y >= (long)_height)
+        continue;
+      long x0 = std::max(0L, -dx), x1 = std::min((long)_width, (long)_width - dx);
+      for (long x = x0; x < x1; x++)
+      {
+        values[y * _width + x] = _values[from_y * _width + x + dx];
+        exact[y * _width + x] = _exact[from_y * _width + x + dx];
+      }
+    }
+    _values.swap(values);
+    _exact.swap(exact);
+    _pass = 0;
+    _next_row = 0;
+  }
+
+  // Refine the rows of a pass from _next_row on, the threads take them one at a time until the
+  // deadline
+  // @return The first row not refined
+  size_t refine_rows(size_t stride, std::chrono::steady_clock::time_point deadline)
+  {
+    const size_t rows = (_height + stride - 1) / stride;
+    unsigned threads = _threads ? _threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, rows));
+    std::atomic<size_t> next_row{_next_row / stride};
+    std::atomic<size_t> computed{0};
+    auto work = [&]
+    {
+      std::vector<uint32_t> columns;
+      std::vector<float> values;
+      while (std::chrono::steady_clock::now() < deadline)
+      {
+        size_t row = next_row++;
+        if (row >= rows)
+          break;
+        computed += refine_row(row * stride, stride, columns, values);
+      }
+    };
+    if (threads <= 1)
+      work();
+    else
+    {
+      std::vector<std::thread> workers;
+      for (unsigned t = 1; t < threads; t++) workers.emplace_back(work);
+      work();
+      for (auto &worker : workers) worker.join();
+    }
+    _cells_computed += computed;
+    // Every row taken was refined, the counter only goes past `rows` by the threads that ran out of rows
+    return std::min(next_row.load(), rows) * stride;
+  }
+
+  // Compute the cells of row y on the stride of the pass that aren't computed yet, and give
+  // the value of every cell on the stride to the cells of its stride x stride block that aren't
+  // @return The number of cells computed
+  size_t refine_row(size_t y, size_t stride, std::vector<uint32_t> &columns, std::vector<float> &values)
+  {
+    columns.clear();
+    for (size_t x = 0; x < _width; x += stride)
+      if (!_exact[y * _width + x])
+        columns.push_back(static_cast<uint32_t>(x));
+    values.resize(columns.size());
+    if (uses_doubles())
+      compute_cells<double>(y, columns.data(), columns.size(), values.data());
+    else
+      compute_cells<float>(y, columns.data(), columns.size(), values.data());
+
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+      _values[y * _width + columns[i]] = values[i];
+      _exact[y * _width + columns[i]] = 1;
+    }
+    // Blocks of cells computed earlier can have cells exposed by a shift too
+    const size_t y1 = std::min(y + stride, _height);
+    for (size_t x = 0; stride > 1 && x < _width; x += stride)
+    {
+      const size_t x1 = std::min(x + stride, _width);
+      const float value = _values[y * _width + x];
+      for (size_t by = y; by < y1; by++)
+        for (size_t bx = x; bx < x1; bx++)
+          if (!_exact[by * _width + bx])
+            _values[by * _width + bx] = value;
+    }
+    return columns.size();
+  }
+
+  // Compute the cells of row y at the given columns
+  // @param out Receives the value of every column
+  template <typename T>
+  void compute_cells(size_t y, const uint32_t *columns, size_t count, float *out) const
+  {
+    const T left = static_cast<T>(_center_x - (_width / 2.0) * _step_x);
+    const T step = static_cast<T>(_step_x);
+    const T ci = static_cast<T>(_center_y + (y - _height / 2.0) * _step_y);
+    size_t i = 0;
+#if defined(__SSE2__)
+    i = compute_lanes<T>(ci, left, step, columns, count, out);
+#endif
+    for (; i < count; i++)
+    {
+      T iterations, magnitude;
+      iterate<T>(left + static_cast<T>(columns[i]) * step, ci, iterations, magnitude);
+      out[i] = smooth(iterations, magnitude);
+    }
+  }
+
+  // Smooth iteration count of an orbit that escaped after `count` iterations at |z|^2 = magnitude
+  float smooth(double count, double magnitude) const
+  {
+    if (magnitude <= bailout)
+      return inside;
+    return static_cast<float>(std::max(0.0, count + 1.0 - std::log2(0.5 * std::log2(magnitude))));
+  }
+
+  // Iterate z = z^2 + c from the point (cr, ci) of the plane
+  // @param count Receives the number of iterations done before escaping
+  // @param magnitude Receives |z|^2 once escaped, 0 when the point is inside
+  template <typename T>
+  void iterate(T cr, T ci, T &count, T &magnitude) const
+  {
+    count = 0;
+    magnitude = 0;
+    T zr = 0, zi = 0;
+    if (_julia)
+    {
+      zr = cr;
+      zi = ci;
+      cr = static_cast<T>(_julia_x);
+      ci = static_cast<T>(_julia_y);
+    }
+    else if (in_main_bulbs(cr, ci))
+      return;
+    const T eps = std::numeric_limits<T>::epsilon() * 4;
+    T saved_r = zr, saved_i = zi;
+    int save_at = 8;
+    for (int n = 0; n < _max_iterations; n++)
+    {
+      T zr2 = zr * zr, zi2 = zi * zi;
+      if (zr2 + zi2 > static_cast<T>(bailout))
+      {
+        count = static_cast<T>(n);
+        magnitude = zr2 + zi2;
+        return;
+      }
+      zi = 2 * zr * zi + ci;
+      zr = zr2 - zi2 + cr;
+      if (std::fabs(zr - saved_r) < eps && std::fabs(zi - saved_i) < eps)
+        return;
+      if (n == save_at)
+      {
+        saved_r = zr;
+        saved_i = zi;
+        save_at *= 2;
+      }
+    }
+  }
+
+  // Main cardioid and period 2 bulb of the Mandelbrot set
+  template <typename T>
+  static bool in_main_bulbs(T cr, T ci)
+  {
+    T xr = cr - T(0.25), q = xr * xr + ci * ci;
+    if (q * (q + xr) <= T(0.25) * ci * ci)
+      return true;
+    return (cr + 1) * (cr + 1) + ci * ci <= T(0.0625);
+  }
+
+#if defined(__SSE2__)
+  template <typename T>
+  using Lanes = typename std::conditional<std::is_same<T, float>::value, fractal_lanes::Floats, fractal_lanes::Doubles>::type;
+
+  // The iterations of `iterate` on Lanes<T>::count cells at a time, lanes that escaped or were
+  // found inside are masked out until every lane is done
+  // @return The first column left for the scalar loop
+  template <typename T>
+  size_t compute_lanes(T ci, T left, T step, const uint32_t *columns, size_t column_count, float *out) const
+  {
+    using L = Lanes<T>;
+    using Vector = typename L::Vector;
+    constexpr int n_lanes = L::count;
+    const Vector zero = L::set1(0), one = L::set1(1), two = L::set1(2), quarter = L::set1(T(0.25));
+    const Vector limit = L::set1(static_cast<T>(bailout));
+    const Vector eps = L::set1(std::numeric_limits<T>::epsilon() * 4);
+    const Vector sign = L::set1(T(-0.0));
+    T lane_x[n_lanes], counts[n_lanes], magnitudes[n_lanes];
+    size_t x = 0;
+    for (; x + n_lanes <= column_count; x += n_lanes)
+    {
+      for (int i = 0; i < n_lanes; i++) lane_x[i] = left + static_cast<T>(columns[x + i]) * step;
+      Vector cr = L::load(lane_x), cim = L::set1(ci);
+      Vector zr = zero, zi = zero;
+      // All ones for the lanes still iterating
+      Vector active = L::less_equal(zero, zero);
+      if (_julia)
+      {
+        zr = cr;
+        zi = cim;
+        cr = L::set1(static_cast<T>(_julia_x));
+        cim = L::set1(static_cast<T>(_julia_y));
+      }
+      else
+      {
+        Vector xr = L::sub(cr, quarter), ci2 = L::mul(cim, cim);
+        Vector q = L::add(L::mul(xr, xr), ci2);
+        Vector cardioid = L::less_equal(L::mul(q, L::add(q, xr)), L::mul(quarter, ci2));
+        Vector xb = L::add(cr, one);
+        Vector bulb = L::less_equal(L::add(L::mul(xb, xb), ci2), L::set1(T(0.0625)));
+        active = L::and_not(L::or_(cardioid, bulb), active);
+      }
+      Vector count = zero, magnitude = zero;
+      Vector saved_r = zr, saved_i = zi;
+      int save_at = 8;
+      for (int n = 0; n < _max_iterations && L::mask(active); n++)
+      {
+        Vector zr2 = L::mul(zr, zr), zi2 = L::mul(zi, zi), mag = L::add(zr2, zi2);
+        Vector escaped = L::and_(L::less(limit, mag), active);
+        magnitude = L::or_(magnitude, L::and_(escaped, mag));
+        active = L::and_not(escaped, active);
+        zi = L::add(L::mul(L::mul(two, zr), zi), cim);
+        zr = L::add(L::sub(zr2, zi2), cr);
+        count = L::add(count, L::and_(active, one));
+        // Orbits back to the saved point are periodic, they never escape
+        Vector dr = L::and_not(sign, L::sub(zr, saved_r)), di = L::and_not(sign, L::sub(zi, saved_i));
+        active = L::and_not(L::and_(L::less(dr, eps), L::less(di, eps)), active);
+        if (n == save_at)
+        {
+          saved_r = zr;
+          saved_i = zi;
+          save_at *= 2;
+        }
+      }
+      L::store(counts, count);
+      L::store(magnitudes, magnitude);
+      for (int i = 0; i < n_lanes; i++) out[x + i] = smooth(counts[i], magnitudes[i]);
+    }
+    return x;
+  }
+#endif
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../dependencies/color.hpp"
+#include "../dependencies/parallel.hpp"
+
+/*!
+ * \class Particle_system
+ *
+ * \brief Particles stored as one array per attribute, so the update streams through plain float
+ * arrays (8 or 4 particles per instruction with AVX or SSE2) and the arrays can be handed to
+ * Renderer::draw_points as they are.
+ *
+ * Every step does, for every particle:
+ *
+ *   velocity = (velocity + gravity * dt) * (1 - drag)
+ *   position += velocity * dt
+ *   age += dt
+ *
+ * then removes the particles whose age reached their lifetime by moving the last particle into
+ * their slot, so the order of the particles is not kept. Large systems are updated in bands on
+ * several threads.
+ *
+ *   Particle_system particles;
+ *   particles.emit(x, y, vx, vy, 3.0f, utl::Color_codes::RED);
+ *   particles.update(dt, 0.0f, 9.8f, 0.01f);
+ *   renderer.draw_points(particles.x(), particles.y(), particles.size(), '*', particles.colors());
+ */
+class Particle_system
+{
+  std::vector<float> _x;          //>> Positions, in cells
+  std::vector<float> _y;
+  std::vector<float> _vx;         //>> Velocities, in cells per second
+  std::vector<float> _vy;
+  std::vector<float> _age;        //>> Seconds since the particle was emitted
+  std::vector<float> _lifetime;   //>> Age the particle is removed at
+  std::vector<Color> _color;
+  unsigned _threads;              //>> Max threads of update, 0 for one per core
+
+public:
+  // @param capacity Particles to reserve room for
+  // @param threads Max threads the update runs on, 0 for one per core
+  Particle_system(size_t capacity = 0, unsigned threads = 0) : _threads(threads) { reserve(capacity); }
+
+  void reserve(size_t capacity)
+  {
+    _x.reserve(capacity);
+    _y.reserve(capacity);
+    _vx.reserve(capacity);
+    _vy.reserve(capacity);
+    _age.reserve(capacity);
+    _lifetime.reserve(capacity);
+    _color.reserve(capacity);
+  }
+
+  // Add a particle
+  void emit(float x, float y, float vx, float vy, float lifetime, Color color)
+  {
+    _x.push_back(x);
+    _y.push_back(y);
+    _vx.push_back(vx);
+    _vy.push_back(vy);
+    _age.push_back(0.0f);
+    _lifetime.push_back(lifetime);
+    _color.push_back(color);
+  }
+
+  // Advance every particle by `dt` seconds and remove the ones that expired
+  // @param gravity_x, gravity_y Acceleration applied to every particle, in cells per second squared
+  // @param drag Fraction of the velocity lost every step
+  void update(float dt, float gravity_x, float gravity_y, float drag)
+  {
+    const size_t count = size();
+    // Bands start on a multiple of 8 so every band but the last runs whole vectors
+    utl::for_each_band(
+        count,
+        utl::band_threads(count, _threads),
+        [&](unsigned, size_t first, size_t last) { integrate(first, last, dt, gravity_x * dt, gravity_y * dt, 1.0f - drag); },
+        8);
+    compact();
+  }
+
+  // Remove particle i, the last particle takes its index
+  void remove(size_t i)
+  {
+    const size_t last = size() - 1;
+    _x[i] = _x[last];
+    _y[i] = _y[last];
+    _vx[i] = _vx[last];
+    _vy[i] = _vy[last];
+    _age[i] = _age[last];
+    _lifetime[i] = _lifetime[last];
+    _color[i] = _color[last];
+    resize(last);
+  }
+
+  void clear() { resize(0); }
+
+  void set_threads(unsigned threads) { _threads = threads; }
+
+  size_t size() const { return _x.size(); }
+  bool empty() const { return _x.empty(); }
+
+  // The attribute arrays, size() values each, written through them take effect on the next update
+  float *x() { return _x.data(); }
+  float *y() { return _y.data(); }
+  float *vx() { return _vx.data(); }
+  float *vy() { return _vy.data(); }
+  const float *x() const { return _x.data(); }
+  const float *y() const { return _y.data(); }
+  const float *vx() const { return _vx.data(); }
+  const float *vy() const { return _vy.data(); }
+  const float *age() const { return _age.data(); }
+  const float *lifetime() const { return _lifetime.data(); }
+  Color *colors() { return _color.data(); }
+  const Color *colors() const { return _color.data(); }
+
+private:
+  void resize(size_t count)
+  {
+    _x.resize(count);
+    _y.resize(count);
+    _vx.resize(count);
+    _vy.resize(count);
+    _age.resize(count);
+    _lifetime.resize(count);
+    _color.resize(count);
+  }
+
+  // @param gx, gy Gravity times dt
+  // @param keep 1 - drag
+  void integrate(size_t first, size_t last, float dt, float gx, float gy, float keep)
+  {
+    float *x = _x.data(), *y = _y.data(), *vx = _vx.data(), *vy = _vy.data(), *age = _age.data();
+    size_t i = first;
+#if defined(__AVX__)
+    const __m256 dtv = _mm256_set1_ps(dt), gxv = _mm256_set1_ps(gx), gyv = _mm256_set1_ps(gy), keepv = _mm256_set1_ps(keep);
+    for (; i + 8 <= last; i += 8)
+    {
+      __m256 nvx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vx + i), gxv), keepv);
+      __m256 nvy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vy + i), gyv), keepv);
+      _mm256_storeu_ps(vx + i, nvx);
+      _mm256_storeu_ps(vy + i, nvy);
+      _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(nvx, dtv)));
+      _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(nvy, dtv)));
+      _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), dtv));
+    }
+#elif defined(__SSE2__)
+    const __m128 dtv = _mm_set1_ps(dt), gxv = _mm_set1_ps(gx), gyv = _mm_set1_ps(gy), keepv = _mm_set1_ps(keep);
+    for (; i + 4 <= last; i += 4)
+    {
+      __m128 nvx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), gxv), keepv);
+      __m128 nvy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), gyv), keepv);
+      _mm_storeu_ps(vx + i, nvx);
+      _mm_storeu_ps(vy + i, nvy);
+      _mm_storeu_ps(x + i, _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(nvx, dtv)));
+      _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(nvy, dtv)));
+      _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dtv));
+    }
+#endif
+    for (; i < last; i++)
+    {
+      vx[i] = (vx[i] + gx) * keep;
+      vy[i] = (vy[i] + gy) * keep;
+      x[i] += vx[i] * dt;
+      y[i] += vy[i] * dt;
+      age[i] += dt;
+    }
+  }
+
+  // Swap-remove the expired particles
+  void compact()
+  {
+    size_t count = size();
+    for (size_t i = 0; i < count;)
+    {
+      if (_age[i] < _lifetime[i])
+      {
+        i++;
+        continue;
+      }
+      count--;
+      _x[i] = _x[count];
+      _y[i] = _y[count];
+      _vx[i] = _vx[count];
+      _vy[i] = _vy[count];
+      _age[i] = _age[count];
+      _lifetime[i] = _lifetime[count];
+      _color[i] = _color[count];
+    }
+    resize(count);
+  }
+};
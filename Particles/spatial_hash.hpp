@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*!
+ * \class Spatial_hash
+ *
+ * \brief Uniform grid of buckets over the screen, one terminal cell per bucket by default, for
+ * neighbour queries between particles or entities.
+ *
+ * The grid is rebuilt from scratch every frame with a counting sort: one pass to count the
+ * positions per bucket, one to turn the counts into offsets and one to scatter the positions,
+ * so a bucket's entries sit next to each other. Positions outside the grid are not indexed.
+ *
+ *   Spatial_hash grid(renderer.get_width(), renderer.get_height());
+ *   grid.build(xs.data(), ys.data(), xs.size());
+ *   grid.query_radius(x, y, 2.0f, [&](uint32_t i) { ... });
+ */
+class Spatial_hash
+{
+  size_t _width = 0;                //>> Buckets per row
+  size_t _height = 0;               //>> Rows of buckets
+  float _cell_size = 1.0f;          //>> Size of a bucket in world units
+  float _inv_cell_size = 1.0f;
+  std::vector<uint32_t> _start{0};  //>> Entries of bucket b are [_start[b], _start[b + 1]), one entry for an empty grid
+  std::vector<uint32_t> _items;     //>> Index of every entry in the arrays given to build, grouped by bucket
+  std::vector<float> _xs;           //>> Positions of the entries, same order as _items
+  std::vector<float> _ys;
+  std::vector<uint32_t> _buckets;   //>> Bucket of every position given to build, ~0u outside the grid
+
+public:
+  Spatial_hash() = default;
+
+  // @param width, height Size of the grid in buckets
+  // @param cell_size Size of a bucket in world units, 1 when positions are terminal cells
+  Spatial_hash(size_t width, size_t height, float cell_size = 1.0f) { resize(width, height, cell_size); }
+
+  void resize(size_t width, size_t height, float cell_size = 1.0f)
+  {
+    _width = width;
+    _height = height;
+    _cell_size = cell_size;
+    _inv_cell_size = 1.0f / cell_size;
+    _start.assign(_width * _height + 1, 0);
+    _items.clear();
+    _xs.clear();
+    _ys.clear();
+  }
+
+  // Index `count` positions, replacing the previous ones
+  void build(const float *xs, const float *ys, size_t count)
+  {
+    const size_t buckets = _width * _height;
+    _buckets.resize(count);
+    std::fill(_start.begin(), _start.end(), 0);
+    for (size_t i = 0; i < count; i++)
+    {
+      // Tested before converting, the conversion of NaN, infinities and huge values is undefined
+      float fx = std::floor(xs[i] * _inv_cell_size), fy = std::floor(ys[i] * _inv_cell_size);
+      if (!(fx >= 0.0f && fx < (float)_width && fy >= 0.0f && fy < (float)_height))
+      {
+        _buckets[i] = ~0u;
+        continue;
+      }
+      _buckets[i] = static_cast<uint32_t>(static_cast<size_t>(fy) * _width + static_cast<size_t>(fx));
+      _start[_buckets[i] + 1]++;
+    }
+    for (size_t b = 0; b < buckets; b++) _start[b + 1] += _start[b];
+
+    const size_t indexed = _start[buckets];
+    _items.resize(indexed);
+    _xs.resize(indexed);
+    _ys.resize(indexed);
+    // Scatter, _start[b] is used as the write cursor of bucket b and restored afterwards
+    for (size_t i = 0; i < count; i++)
+    {
+      if (_buckets[i] == ~0u)
+        continue;
+      uint32_t at = _start[_buckets[i]]++;
+      _items[at] = static_cast<uint32_t>(i);
+      _xs[at] = xs[i];
+      _ys[at] = ys[i];
+    }
+    for (size_t b = buckets; b > 0; b--) _start[b] = _start[b - 1];
+    _start[0] = 0;
+  }
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  float cell_size() const { return _cell_size; }
+
+  // Number of positions indexed by the last build
+  size_t size() const { return _items.size(); }
+
+  // Number of positions in bucket (x, y), e.g. to shade cells by density
+  uint32_t occupancy(size_t x, size_t y) const { return _start[y * _width + x + 1] - _start[y * _width + x]; }
+
+  // Indices of the positions in bucket (x, y)
+  std::pair<const uint32_t *, const uint32_t *> bucket(size_t x, size_t y) const
+  {
+    size_t b = y * _width + x;
+    return {_items.data() + _start[b], _items.data() + _start[b + 1]};
+  }
+
+  // Call fn(index) for every position within `radius` of (x, y)
+  template <typename Fn>
+  void query_radius(float x, float y, float radius, Fn fn) const
+  {
+    const float radius2 = radius * radius;
+    for_each_bucket(x - radius, y - radius, x + radius, y + radius,
+                    [&](size_t b)
+                    {
+                      for (uint32_t i = _start[b]; i < _start[b + 1]; i++)
+                      {
+                        float dx = _xs[i] - x, dy = _ys[i] - y;
+                        if (dx * dx + dy * dy <= radius2)
+                          fn(_items[i]);
+                      }
+                    });
+  }
+
+  // Call fn(index) for every position in the rectangle [min_x, max_x] x [min_y, max_y]
+  template <typename Fn>
+  void query_rect(float min_x, float min_y, float max_x, float max_y, Fn fn) const
+  {
+    for_each_bucket(min_x, min_y, max_x, max_y,
+                    [&](size_t b)
+                    {
+                      for (uint32_t i = _start[b]; i < _start[b + 1]; i++)
+                        if (_xs[i] >= min_x && _xs[i] <= max_x && _ys[i] >= min_y && _ys[i] <= max_y)
+                          fn(_items[i]);
+                    });
+  }
+
+  // The `k` positions nearest to (x, y) within `max_radius`, searched ring by ring of buckets
+  // @param out Receives the indices, nearest first, room for `k` of them
+  // @return The number of positions found, at most k
+  size_t nearest(float x, float y, size_t k, uint32_t *out, float max_radius = INFINITY) const
+  {
+    if (k == 0 || _items.empty() || !std::isfinite(x) || !std::isfinite(y))
+      return 0;
+    // Max heap on the distance of the k best so far
+    std::vector<std::pair<float, uint32_t>> best;
+    best.reserve(k + 1);
+    const float max_radius2 = max_radius * max_radius;
+    // Bucket of the query, queries off the grid start from the bucket just outside its edge, the
+    // rings around it are no closer to the query than they are to that bucket
+    const long cx = to_bucket(x * _inv_cell_size, -1, (long)_width);
+    const long cy = to_bucket(y * _inv_cell_size, -1, (long)_height);
+    // Past this ring the square is entirely off the grid
+    const long max_ring = std::max({cx, (long)_width - 1 - cx, cy, (long)_height - 1 - cy});
+    auto visit = [&](long bx, long by)
+    {
+      size_t b = by * _width + bx;
+      for (uint32_t i = _start[b]; i < _start[b + 1]; i++)
+      {
+        float dx = _xs[i] - x, dy = _ys[i] - y, d2 = dx * dx + dy * dy;
+        if (d2 > max_radius2 || (best.size() == k && d2 >= best.front().first))
+          continue;
+        best.push_back({d2, _items[i]});
+        std::push_heap(best.begin(), best.end());
+        if (best.size() > k)
+        {
+          std::pop_heap(best.begin(), best.end());
+          best.pop_back();
+        }
+      }
+    };
+    for (long ring = 0; ring <= max_ring; ring++)
+    {
+      // Every position in this ring or further is at least (ring - 1) buckets away
+      float reach = std::max(0L, ring - 1) * _cell_size;
+      if ((best.size() == k && reach * reach > best.front().first) || reach * reach > max_radius2)
+        break;
+      // Only the border of the square, its top and bottom rows then its left and right columns,
+      // clamped to the grid
+      const long x0 = cx - ring, x1 = cx + ring, y0 = cy - ring, y1 = cy + ring;
+      const long row_x0 = std::max(0L, x0), row_x1 = std::min((long)_width - 1, x1);
+      const long column_y0 = std::max(0L, y0 + 1), column_y1 = std::min((long)_height - 1, y1 - 1);
+      if (y0 >= 0 && y0 < (long)_height)
+        for (long bx = row_x0; bx <= row_x1; bx++) visit(bx, y0);
+      if (ring > 0 && y1 >= 0 && y1 < (long)_height)
+        for (long bx = row_x0; bx <= row_x1; bx++) visit(bx, y1);
+      if (x0 >= 0 && x0 < (long)_width)
+        for (long by = column_y0; by <= column_y1; by++) visit(x0, by);
+      if (ring > 0 && x1 >= 0 && x1 < (long)_width)
+        for (long by = column_y0; by <= column_y1; by++) visit(x1, by);
+    }
+    std::sort_heap(best.begin(), best.end());
+    for (size_t i = 0; i < best.size(); i++) out[i] = best[i].second;
+    return best.size();
+  }
+
+private:
+  // floor(v) clamped to [lo, hi], clamped before converting so NaN (to lo), infinities and huge
+  // values don't overflow the conversion
+  static long to_bucket(float v, long lo, long hi)
+  {
+    v = std::floor(v);
+    if (!(v > (float)lo))
+      return lo;
+    return v < (float)hi ? static_cast<long>(v) : hi;
+  }
+
+  // Call fn(bucket) for the buckets overlapping a rectangle of the world
+  template <typename Fn>
+  void for_each_bucket(float min_x, float min_y, float max_x, float max_y, Fn fn) const
+  {
+    long bx0 = to_bucket(min_x * _inv_cell_size, 0, (long)_width);
+    long by0 = to_bucket(min_y * _inv_cell_size, 0, (long)_height);
+    long bx1 = to_bucket(max_x * _inv_cell_size, -1, (long)_width - 1);
+    long by1 = to_bucket(max_y * _inv_cell_size, -1, (long)_height - 1);
+    for (long by = by0; by <= by1; by++)
+      for (long bx = bx0; bx <= bx1; bx++) fn(by * _width + bx);
+  }
+};
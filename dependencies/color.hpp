@@ -148,17 +148,8 @@ public:
     return *this;
   }
 
-  Color &operator=(const Color &c)
-  {
-    if (this != &c)
-    {
-      _r = c.r();
-      _g = c.g();
-      _b = c.b();
-      _a = c.a();
-    }
-    return *this;
-  }
+  // Trivially copyable, so arrays of colors can be filled and copied as plain bytes
+  Color &operator=(const Color &c) = default;
 
   bool operator!=(const uint32_t &hex_val) const
   {
@@ -169,7 +160,7 @@ public:
 
   bool operator==(const Color &c) const { return _r == c.r() && _g == c.g() && _b == c.b() && _a == c.a(); }
 
-  Color(const Color &c) : _r(c.r()), _g(c.g()), _b(c.b()), _a(c.a()) {}
+  Color(const Color &c) = default;
 
   // Accessors
   uint8_t &r() { return _r; }
@@ -213,6 +204,9 @@ public:
     return "\u001b[48;5;" + std::to_string(code) + "m";
   }
 
+  // Rec. 601 luminance in fixed point, weights sum to 256
+  uint8_t luma() const { return static_cast<uint8_t>((77 * _r + 150 * _g + 29 * _b + 128) >> 8); }
+
   Color gray_scale() const
   {
     uint8_t gray = static_cast<uint8_t>(0.3 * _r + 0.59 * _g + 0.11 * _b);
@@ -223,7 +217,7 @@ public:
 
   Color blend(const Color &c) const { return Color((_r + c.r()) / 2, (_g + c.g()) / 2, (_b + c.b()) / 2); }
 
-  Color blend(const Color &c, float blend)
+  Color blend(const Color &c, float blend) const
   {
     return Color(static_cast<uint8_t>(_r * (1 - blend) + c.r() * blend),
                  static_cast<uint8_t>(_g * (1 - blend) + c.g() * blend),
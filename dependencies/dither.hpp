@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "./color.hpp"
+#include "./sprites.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Dithering of the two quantization steps of the ASCII pipeline
+//  - luminance to a character of a ramp (char_gradient by default)
+//  - RGB to the 256 color palette Color::to_ansii() maps to, the colors are snapped to the
+//    values that palette shows so to_ansii() then picks the dithered entry exactly: grays
+//    (r == g == b) to the 24 step gray ramp plus black and white, other colors to the 6x6x6
+//    cube levels (multiples of 51), and a cube color with equal channels to the ramp entry
+//    to_ansii() shows it as
+//
+// ORDERED uses an 8x8 Bayer matrix, every cell only depends on its own value and position so
+// any band of rows can be processed independently (and on several threads).
+// FLOYD_STEINBERG diffuses the quantization error to the neighbours, scanning rows in a
+// serpentine order, it is sequential and gives smoother gradients.
+
+namespace utl
+{
+
+  enum class Dither_mode
+  {
+    NONE,
+    ORDERED,
+    FLOYD_STEINBERG
+  };
+
+  namespace dither
+  {
+    // Bayer matrix, thresholds are (bayer8[y][x] + 0.5) / 64
+    static constexpr uint8_t bayer8[8][8] = {{0, 32, 8, 40, 2, 34, 10, 42},
+                                              {48, 16, 56, 24, 50, 18, 58, 26},
+                                              {12, 44, 4, 36, 14, 46, 6, 38},
+                                              {60, 28, 52, 20, 62, 30, 54, 22},
+                                              {3, 35, 11, 43, 1, 33, 9, 41},
+                                              {51, 19, 59, 27, 49, 17, 57, 25},
+                                              {15, 47, 7, 39, 13, 45, 5, 37},
+                                              {63, 31, 55, 23, 61, 29, 53, 21}};
+
+    // Distance between two levels of the color cube as seen by Color::to_ansii()
+    static constexpr int cube_step = 51;
+
+    // Offset added to a channel before rounding it to the cube, centered on 0
+    inline int cube_bias(int threshold) { return ((2 * threshold + 1 - 64) * cube_step) / 128; }
+
+    // Nearest cube level of a channel value, (v * 5 + 127) / 255 with a multiply and shift
+    inline int cube_level(int v) { return ((v * 5 + 127 + 1) * 257) >> 16; }
+
+    // Distance between two entries of the gray ramp, 8 + 10 n for n in [0, 23]
+    static constexpr int gray_step = 10;
+
+    // Gray Color::to_ansii() can show at or below v
+    inline int gray_floor(int v)
+    {
+      if (v < 8)
+        return 0;
+      if (v >= 238)
+        return 238;
+      return 8 + gray_step * ((v - 8) / gray_step);
+    }
+
+    // Next gray Color::to_ansii() can show above `level`, the gaps at both ends are not gray_step
+    inline int gray_ceil(int level) { return level == 0 ? 8 : level == 238 ? 255 : level + gray_step; }
+
+    // Nearest gray Color::to_ansii() can show: black, an entry of the ramp or white
+    inline int gray_level(int v)
+    {
+      if (v < 4)
+        return 0;
+      if (v >= 247)
+        return 255;
+      return 8 + gray_step * std::min((v - 3) / gray_step, 23);
+    }
+
+    // The gray Color::to_ansii() shows for the color (v, v, v)
+    inline int shown_gray(int v)
+    {
+      if (v < 8)
+        return 0;
+      if (v > 248)
+        return 255;
+      return 8 + gray_step * ((v - 8) / gray_step);
+    }
+
+    inline bool is_gray(const Color &c) { return c.r() == c.g() && c.g() == c.b(); }
+
+    // Ordered dithering of one color to the palette, grays to the gray ramp
+    inline void ordered_color(Color &c, int threshold)
+    {
+      if (is_gray(c))
+      {
+        // The threshold picks between the two grays around the value
+        int low = gray_floor(c.r()), high = gray_ceil(low);
+        uint8_t v = static_cast<uint8_t>((c.r() - low) * 128 > (2 * threshold + 1) * (high - low) ? high : low);
+        c.r() = c.g() = c.b() = v;
+        return;
+      }
+      int bias = cube_bias(threshold);
+      c.r() = static_cast<uint8_t>(cube_level(std::clamp(c.r() + bias, 0, 255)) * cube_step);
+      c.g() = static_cast<uint8_t>(cube_level(std::clamp(c.g() + bias, 0, 255)) * cube_step);
+      c.b() = static_cast<uint8_t>(cube_level(std::clamp(c.b() + bias, 0, 255)) * cube_step);
+      if (is_gray(c))
+        c.r() = c.g() = c.b() = static_cast<uint8_t>(shown_gray(c.r()));
+    }
+
+    // Character of `ramp` for every (threshold, luminance) pair
+    // @param ramp At least two characters, from darkest to brightest
+    inline std::vector<char> ordered_glyph_table(const std::vector<char> &ramp)
+    {
+      std::vector<char> table(64 * 256);
+      const int levels = static_cast<int>(ramp.size()) - 1;
+      for (int t = 0; t < 64; t++)
+        for (int v = 0; v < 256; v++)
+        {
+          // floor(v / 255 * levels + (t + 0.5) / 64)
+          int index = (v * levels * 128 + (2 * t + 1) * 255) / (255 * 128);
+          table[t * 256 + v] = ramp[std::min(index, levels)];
+        }
+      return table;
+    }
+
+    // Ordered dithering of luminance values to the characters of a ramp
+    // @param luma `rows` rows of `width` luminance values
+    // @param characters Receives the characters, same layout
+    // @param first_row Row of the image `luma` starts at, sets the phase of the matrix
+    // @param table Table from ordered_glyph_table()
+    inline void ordered_glyphs(
+        const uint8_t *luma, char *characters, size_t width, size_t rows, size_t first_row, const std::vector<char> &table)
+    {
+      for (size_t y = 0; y < rows; y++)
+      {
+        const uint8_t *row = bayer8[(first_row + y) & 7];
+        const uint8_t *src = luma + y * width;
+        char *dst = characters + y * width;
+        for (size_t x = 0; x < width; x++) dst[x] = table[row[x & 7] * 256 + src[x]];
+      }
+    }
+
+    // Ordered dithering of colors to the color cube, in place, alpha is kept
+    // @param colors `rows` rows of `width` colors
+    // @param first_row Row of the image `colors` starts at, sets the phase of the matrix
+    inline void ordered_colors(Color *colors, size_t width, size_t rows, size_t first_row)
+    {
+      static_assert(sizeof(Color) == 4, "Color is processed as 4 packed bytes");
+      for (size_t y = 0; y < rows; y++)
+      {
+        const uint8_t *row = bayer8[(first_row + y) & 7];
+        Color *c = colors + y * width;
+        size_t x = 0;
+#if defined(__SSE2__)
+        // 4 colors per iteration, the 8 biases of the row are two pairs of vectors of 2 pixels
+        __m128i bias[4];
+        for (int i = 0; i < 4; i++)
+        {
+          int16_t b0 = static_cast<int16_t>(cube_bias(row[2 * i]));
+          int16_t b1 = static_cast<int16_t>(cube_bias(row[2 * i + 1]));
+          bias[i] = _mm_setr_epi16(b0, b0, b0, 0, b1, b1, b1, 0);
+        }
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max = _mm_set1_epi16(255);
+        const __m128i five = _mm_set1_epi16(5);
+        const __m128i round = _mm_set1_epi16(128);
+        const __m128i div255 = _mm_set1_epi16(257);
+        const __m128i step = _mm_set1_epi16(cube_step);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        for (; x + 4 <= width; x += 4)
+        {
+          __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(c + x));
+          const __m128i *b = bias + (x & 4 ? 2 : 0);
+          __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(px, zero), b[0]);
+          __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(px, zero), b[1]);
+          lo = _mm_min_epi16(_mm_max_epi16(lo, zero), max);
+          hi = _mm_min_epi16(_mm_max_epi16(hi, zero), max);
+          lo = _mm_mullo_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_mullo_epi16(lo, five), round), div255), step);
+          hi = _mm_mullo_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_mullo_epi16(hi, five), round), div255), step);
+          __m128i out = _mm_packus_epi16(lo, hi);
+          out = _mm_or_si128(_mm_andnot_si128(alpha, out), _mm_and_si128(alpha, px));
+          Color source[4];
+          std::memcpy(source, c + x, sizeof(source));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(c + x), out);
+          // Grays in or out go to the gray ramp instead
+          for (int i = 0; i < 4; i++)
+            if (is_gray(source[i]) || is_gray(c[x + i]))
+            {
+              c[x + i] = source[i];
+              ordered_color(c[x + i], row[(x + i) & 7]);
+            }
+        }
+#endif
+        for (; x < width; x++) ordered_color(c[x], row[x & 7]);
+      }
+    }
+
+    // Floyd-Steinberg dithering of a luminance plane to the characters of a ramp
+    inline void diffuse_glyphs(const uint8_t *luma, char *characters, size_t width, size_t height, const std::vector<char> &ramp)
+    {
+      const int levels = static_cast<int>(ramp.size()) - 1;
+      // Errors in 1/16 units, one guard cell on both sides
+      std::vector<int> current(width + 2, 0), next(width + 2, 0);
+      for (size_t y = 0; y < height; y++)
+      {
+        bool reverse = y & 1;
+        int dir = reverse ? -1 : 1;
+        for (size_t i = 0; i < width; i++)
+        {
+          size_t x = reverse ? width - 1 - i : i;
+          int v = luma[y * width + x] * 16 + current[x + 1];
+          int index = std::clamp((v * levels + 255 * 8) / (255 * 16), 0, levels);
+          characters[y * width + x] = ramp[index];
+          int error = (v - index * 255 * 16 / levels) / 16;
+          current[x + 1 + dir] += error * 7;
+          next[x + 1 - dir] += error * 3;
+          next[x + 1] += error * 5;
+          next[x + 1 + dir] += error;
+        }
+        std::swap(current, next);
+        std::fill(next.begin(), next.end(), 0);
+      }
+    }
+
+    // Floyd-Steinberg dithering of colors to the color cube, in place, alpha is kept
+    inline void diffuse_colors(Color *colors, size_t width, size_t height)
+    {
+      // Errors in 1/16 units per channel, one guard cell on both sides
+      std::vector<std::array<int, 3>> current(width + 2, {0, 0, 0}), next(width + 2, {0, 0, 0});
+      for (size_t y = 0; y < height; y++)
+      {
+        bool reverse = y & 1;
+        int dir = reverse ? -1 : 1;
+        for (size_t i = 0; i < width; i++)
+        {
+          size_t x = reverse ? width - 1 - i : i;
+          Color &c = colors[y * width + x];
+          uint8_t *channels[3] = {&c.r(), &c.g(), &c.b()};
+          int v[3], q[3];
+          for (int k = 0; k < 3; k++) v[k] = std::clamp(*channels[k] + (current[x + 1][k] + 8) / 16, 0, 255);
+          if (is_gray(c))
+          {
+            // Grays stay gray, on the gray ramp
+            q[0] = q[1] = q[2] = gray_level((v[0] + v[1] + v[2] + 1) / 3);
+          }
+          else
+          {
+            for (int k = 0; k < 3; k++) q[k] = cube_level(v[k]) * cube_step;
+            if (q[0] == q[1] && q[1] == q[2])
+              q[0] = q[1] = q[2] = shown_gray(q[0]);
+          }
+          // The error is measured against what the terminal shows
+          for (int k = 0; k < 3; k++)
+          {
+            *channels[k] = static_cast<uint8_t>(q[k]);
+            int error = v[k] - q[k];
+            current[x + 1 + dir][k] += error * 7;
+            next[x + 1 - dir][k] += error * 3;
+            next[x + 1][k] += error * 5;
+            next[x + 1 + dir][k] += error;
+          }
+        }
+        std::swap(current, next);
+        std::fill(next.begin(), next.end(), std::array<int, 3>{0, 0, 0});
+      }
+    }
+  }  // namespace dither
+
+  // Requantize the characters of a sprite from the luminance of its colors, then snap its
+  // colors to the terminal color cube, both dithered with `mode`
+  // @param ramp Characters from darkest to brightest
+  inline void dither_sprite(Sprite &sprite, Dither_mode mode, const std::vector<char> &ramp = char_gradient)
+  {
+    size_t width = sprite.width(), height = sprite.height();
+    if (mode == Dither_mode::NONE || width == 0 || height == 0 || ramp.size() < 2)
+      return;
+
+    Color *colors = sprite.color_data();
+    std::vector<uint8_t> luma(width * height);
+    for (size_t i = 0; i < luma.size(); i++) luma[i] = colors[i].luma();
+
+    if (mode == Dither_mode::ORDERED)
+    {
+      dither::ordered_glyphs(luma.data(), sprite.character_data(), width, height, 0, dither::ordered_glyph_table(ramp));
+      dither::ordered_colors(colors, width, height, 0);
+    }
+    else
+    {
+      dither::diffuse_glyphs(luma.data(), sprite.character_data(), width, height, ramp);
+      dither::diffuse_colors(colors, width, height);
+    }
+  }
+
+}  // namespace utl
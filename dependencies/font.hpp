@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "glyph.hpp"
+
 class Font_glyph
 {
 public:
@@ -16,10 +23,13 @@ public:
     // Default constructor
     Font_glyph() : lines(), width(0), height(0) {}
 
+    // Rows shorter than the longest one are padded with spaces
     Font_glyph(const std::vector<std::string> &_lines) : lines(_lines)
     {
         height = lines.size();
-        width = lines.empty() ? 0 : lines[0].length();
+        width = 0;
+        for (const auto &line : lines) width = std::max(width, static_cast<int>(line.length()));
+        for (auto &line : lines) line.resize(width, ' ');
     }
 
     Font_glyph(const Font_glyph &other) : lines(other.lines), width(other.width), height(other.height) {}
@@ -42,26 +52,71 @@ public:
     std::vector<std::string> get_lines() { return lines; }
 };
 
+// Glyphs indexed by character through a flat 256 entry table, with the bitmaps of all the
+// glyphs stored back to back (rows padded to the glyph width) for the renderer to read
 class Font
 {
 private:
-    std::unordered_map<char, Font_glyph> glyphs;
+    std::array<int16_t, 256> index;   // Slot of every character in glyphs, -1 when missing
+    std::vector<Font_glyph> glyphs;   // Glyphs in the order they were added
+    std::vector<size_t> offsets;      // Start of every glyph in bitmaps
+    std::vector<char> bitmaps;        // All the glyph rows, back to back
+    uint64_t id = 0;                  // Changes with the content, for caches keyed by font
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
 
 public:
-    Font() : glyphs(std::unordered_map<char, Font_glyph>()) {}
-    Font(const std::string &filename) { load_from_file(filename); }
-    Font(std::unordered_map<char, Font_glyph> _glyphs) : glyphs(_glyphs) {}
-    Font(std::unordered_map<char, Font_glyph> &_glyphs) : glyphs(_glyphs) {}
-    Font(std::unordered_map<char, std::vector<std::string>> _glyphs)
+    Font() { clear(); }
+    Font(const std::string &filename)
+    {
+        clear();
+        load_from_file(filename);
+    }
+    Font(const std::unordered_map<char, Font_glyph> &_glyphs)
+    {
+        clear();
+        for (auto &[c, glyph] : _glyphs) add_glyph(c, glyph.get_lines());
+    }
+    Font(const std::unordered_map<char, std::vector<std::string>> &_glyphs)
+    {
+        clear();
+        for (auto &[c, lines] : _glyphs) add_glyph(c, lines);
+    }
+    Font(const std::vector<std::pair<char, std::vector<std::string>>> &_glyphs)
     {
-        for (auto &[c, lines] : _glyphs) glyphs[c] = Font_glyph(lines);
+        clear();
+        for (auto &[c, lines] : _glyphs) add_glyph(c, lines);
     }
-    Font(std::vector<std::pair<char, std::vector<std::string>>> _glyphs)
+    Font(const Font &other) = default;
+    Font &operator=(const Font &other) = default;
+
+    // The moved-from font is left empty, its index must not keep pointing into the moved glyphs
+    Font(Font &&other) noexcept
+        : index(other.index),
+          glyphs(std::move(other.glyphs)),
+          offsets(std::move(other.offsets)),
+          bitmaps(std::move(other.bitmaps)),
+          id(other.id)
     {
-        for (auto &[c, lines] : _glyphs) glyphs[c] = Font_glyph(lines);
+        other.clear();
     }
-    Font(const Font &other) : glyphs(other.glyphs) {}
-    Font(Font &&other) : glyphs(std::move(other.glyphs)) {}
+    Font &operator=(Font &&other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        index = other.index;
+        glyphs = std::move(other.glyphs);
+        offsets = std::move(other.offsets);
+        bitmaps = std::move(other.bitmaps);
+        id = other.id;
+        other.clear();
+        return *this;
+    }
+
     bool load_from_file(const std::string &filename)
     {
         std::ifstream file(filename);
@@ -71,6 +126,7 @@ public:
             return false;
         }
 
+        clear();
         std::string line;
         int width = 0, height = 0;
 
@@ -121,49 +177,95 @@ public:
                 sprite_lines.push_back(line.substr(0, width));      // trim line if it's too long
             }
 
-            glyphs[sprite_char] = Font_glyph(sprite_lines);
+            add_glyph(sprite_char, sprite_lines);
         }
 
-        glyphs[' '] = Font_glyph(std::vector<std::string>(height, std::string(((width < 4) ? width : width - 2), ' ')));
+        add_glyph(' ', std::vector<std::string>(height, std::string(((width < 4) ? width : width - 2), ' ')));
 
         file.close();
         return true;
     }
 
+    // Get the glyph of `c`, a blank glyph with a warning if the font doesn't have it
     const Font_glyph &get_glyph(char c) const
     {
         static const Font_glyph default_glyph({" "});  // Default glyph representation
-        auto it = glyphs.find(c);
-        if (it != glyphs.end())
-            return it->second;
+        const Font_glyph *glyph = find_glyph(c);
+        if (glyph)
+            return *glyph;
         // Print a warning message
         std::cerr << "Warning: Glyph for character '" << c << "' not found. Using default glyph." << std::endl;
         return default_glyph;
     }
 
-    Font &operator=(const Font &other)
+    // Get the glyph of `c`, nullptr if the font doesn't have it
+    const Font_glyph *find_glyph(char c) const
     {
-        if (this != &other)
-            glyphs = other.glyphs;
-        return *this;
+        int16_t slot = index[static_cast<unsigned char>(c)];
+        return slot < 0 ? nullptr : &glyphs[slot];
     }
 
-    Font &operator=(Font &&other) noexcept
+    // Get the bitmap of `c`, get_height() rows of get_width() characters, data is null if the font doesn't have it
+    Glyph_view get_bitmap(char c) const
     {
-        if (this != &other)
-            glyphs = std::move(other.glyphs);
-        return *this;
+        int16_t slot = index[static_cast<unsigned char>(c)];
+        if (slot < 0)
+            return {};
+        return {bitmaps.data() + offsets[slot], glyphs[slot].get_width(), glyphs[slot].get_height()};
     }
 
-    bool has_glyph(char c) const { return glyphs.find(c) != glyphs.end(); }
+    bool has_glyph(char c) const { return index[static_cast<unsigned char>(c)] >= 0; }
 
-    void add_glyph(char c, const std::vector<std::string> &lines) { glyphs[c] = Font_glyph(lines); }
+    void add_glyph(char c, const std::vector<std::string> &lines)
+    {
+        Font_glyph glyph(lines);
+        int16_t &slot = index[static_cast<unsigned char>(c)];
+        if (slot >= 0)
+        {
+            // Replacing a glyph can change its size, so the rows after it are packed again
+            glyphs[slot] = glyph;
+            rebuild_bitmaps();
+            return;
+        }
+        // A new glyph only appends its rows, so loading n glyphs stays linear
+        slot = static_cast<int16_t>(glyphs.size());
+        glyphs.push_back(glyph);
+        offsets.push_back(bitmaps.size());
+        for (const auto &line : glyph.get_lines()) bitmaps.insert(bitmaps.end(), line.begin(), line.end());
+        id = next_id();
+    }
 
     std::vector<char> get_available_chars() const
     {
         std::vector<char> chars;
         chars.reserve(glyphs.size());
-        for (const auto &[c, _] : glyphs) chars.push_back(c);
+        for (int c = 0; c < 256; c++)
+            if (index[c] >= 0)
+                chars.push_back(static_cast<char>(c));
         return chars;
     }
+
+    // Identifies the content of the font, changes whenever a glyph is added or replaced
+    uint64_t get_id() const { return id; }
+
+    void clear()
+    {
+        index.fill(-1);
+        glyphs.clear();
+        offsets.clear();
+        bitmaps.clear();
+        id = next_id();
+    }
+
+private:
+    void rebuild_bitmaps()
+    {
+        bitmaps.clear();
+        for (size_t i = 0; i < glyphs.size(); i++)
+        {
+            offsets[i] = bitmaps.size();
+            for (const auto &line : glyphs[i].get_lines()) bitmaps.insert(bitmaps.end(), line.begin(), line.end());
+        }
+        id = next_id();
+    }
 };
@@ -1,13 +1,27 @@
 #pragma once
 
 #include <cmath>
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 #define L_GEBRA_IMPLEMENTATION
 #include "../l_gebra/l_gebra.hpp"
 
+// Non owning view of a glyph stored as `height` rows of `width` characters, back to back
+struct Glyph_view
+{
+    const char *data = nullptr;
+    int width = 0;
+    int height = 0;
+
+    const char *row(int y) const { return data + static_cast<size_t>(y) * width; }
+    char get_char(int x, int y) const { return x < 0 || y < 0 || x >= width || y >= height ? ' ' : data[y * width + x]; }
+};
+
 class Glyph
 {
 private:
@@ -26,7 +40,14 @@ public:
                 width = static_cast<int>(line.length());
         pad_lines_to_width();
     }
+    // Copy the characters of a view, e.g. a frame of an Animated_glyph
+    Glyph(Glyph_view view) : width(view.width), height(view.height)
+    {
+        data.reserve(height);
+        for (int y = 0; y < view.height; y++) data.emplace_back(view.row(y), view.width);
+    }
     Glyph(const Glyph &other) = default;
+    Glyph &operator=(const Glyph &other) = default;
     ~Glyph() = default;
 
     char get_char(size_t x, size_t y) const
@@ -38,7 +59,7 @@ public:
 
     int get_width() const { return width; }
     int get_height() const { return height; }
-    std::vector<std::string> get_data() const { return data; }
+    const std::vector<std::string> &get_data() const { return data; }
 
     bool load_from_file(const std::string &filename)
     {
@@ -157,9 +178,19 @@ public:
     }
 };
 
+// Frames of an animation stored in one buffer, frame i is `height` rows of `width`
+// characters starting at offset, so drawing a frame doesn't copy it (see Glyph_view)
 class Animated_glyph
 {
-    std::vector<Glyph> frames;
+    struct Frame
+    {
+        size_t offset;
+        int width;
+        int height;
+    };
+
+    std::vector<char> frame_data;
+    std::vector<Frame> frames;
     int current_frame = 0;
     float frame_time = 0;
     float frame_duration = 0;
@@ -170,8 +201,9 @@ class Animated_glyph
 public:
     Animated_glyph() = default;
     Animated_glyph(const std::vector<Glyph> &frames, float frame_duration, float scale_x = 1.0f, float scale_y = 1.0f, int FPS = 1)
-        : frames(frames), current_frame(0), frame_time(0), frame_duration(frame_duration), scale_x(scale_x), scale_y(scale_y), FPS(FPS)
+        : current_frame(0), frame_time(0), frame_duration(frame_duration), scale_x(scale_x), scale_y(scale_y), FPS(FPS)
     {
+        for (const auto &frame : frames) add_frame(frame.get_data());
     }
 
     void load_from_file(const std::string &filename)
@@ -217,7 +249,7 @@ public:
             {
                 if (!current_frame_data.empty())
                 {
-                    frames.emplace_back(current_frame_data);
+                    add_frame(current_frame_data);
                     current_frame_data.clear();
                 }
             }
@@ -225,34 +257,45 @@ public:
             {
                 if (!current_frame_data.empty())
                 {
-                    frames.emplace_back(current_frame_data);
+                    add_frame(current_frame_data);
                     current_frame_data.clear();
                 }
                 frame_number = std::stoi(line);
             }
             else  // Frame data
-            {
-                // Ensure the width consistency by padding with spaces
-                if (!current_frame_data.empty())
-                {
-                    size_t max_width = 0;
-                    for (const auto &row : current_frame_data) max_width = std::max(max_width, row.size());
-                    for (auto &row : current_frame_data) row.resize(max_width, ' ');
-                }
                 current_frame_data.push_back(line);
-            }
         }
 
         // Add the last frame if any
         if (!current_frame_data.empty())
-            frames.emplace_back(current_frame_data);
+            add_frame(current_frame_data);
 
         file.close();
     }
 
-    Glyph get_current_frame() const { return frames[current_frame]; }
-    Glyph get_frame(int index) const { return frames[index]; }
-    Glyph update(float dt)
+    // Append a frame, rows are padded with spaces to the longest one
+    void add_frame(const std::vector<std::string> &rows)
+    {
+        Frame frame{frame_data.size(), 0, static_cast<int>(rows.size())};
+        for (const auto &row : rows) frame.width = std::max(frame.width, static_cast<int>(row.size()));
+        frame_data.resize(frame_data.size() + static_cast<size_t>(frame.width) * frame.height, ' ');
+        for (size_t y = 0; y < rows.size(); y++) std::copy(rows[y].begin(), rows[y].end(), frame_data.begin() + frame.offset + y * frame.width);
+        frames.push_back(frame);
+    }
+
+    Glyph_view get_view(int index) const
+    {
+        const Frame &frame = frames[index];
+        return {frame_data.data() + frame.offset, frame.width, frame.height};
+    }
+    Glyph_view get_current_view() const { return get_view(current_frame); }
+
+    Glyph get_current_frame() const { return Glyph(get_current_view()); }
+    Glyph get_frame(int index) const { return Glyph(get_view(index)); }
+
+    // Advance the animation by `dt` seconds
+    // @return A view of the current frame, valid until frames are added
+    Glyph_view update(float dt)
     {
         frame_time += dt;
         if (frame_time >= frame_duration)
@@ -260,8 +303,103 @@ public:
             frame_time = 0;
             current_frame = (current_frame + 1) % static_cast<int>(frames.size());
         }
-        return frames[current_frame];
+        return get_current_view();
     }
     size_t get_frame_count() const { return frames.size(); }
+    int get_current_index() const { return current_frame; }
+    float get_frame_duration() const { return frame_duration; }
     void set_frame_duration(float duration) { frame_duration = duration; }
 };
+
+// Advances many instances of Animated_glyph clips at once
+// Each instance only holds its clip, frame, clock and frame duration, stored as separate arrays
+// so update() is one pass over contiguous floats; the frames themselves stay in the clips.
+//
+//   Glyph_animator animator;
+//   size_t id = animator.add(&explosion);
+//   animator.update(dt);
+//   renderer.draw_glyph(position, animator.view(id));
+class Glyph_animator
+{
+    std::vector<const Animated_glyph *> clips;
+    std::vector<uint32_t> frame;
+    std::vector<uint32_t> frame_count;
+    std::vector<float> time;
+    std::vector<float> duration;
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);  // Returned by add when the clip can't be animated
+
+    // Add an instance of `clip`, which must outlive the animator
+    // @param frame_duration Seconds per frame, the clip's duration if negative
+    // @param start_frame First frame shown, lets instances of the same clip run out of phase
+    // @return The index of the instance, npos for a null clip or a clip without frames
+    size_t add(const Animated_glyph *clip, float frame_duration = -1.0f, uint32_t start_frame = 0)
+    {
+        if (!clip || clip->get_frame_count() == 0)
+        {
+            std::cerr << "Error: Cannot animate a glyph clip without frames." << std::endl;
+            return npos;
+        }
+        uint32_t count = static_cast<uint32_t>(clip->get_frame_count());
+        clips.push_back(clip);
+        frame.push_back(start_frame % count);
+        frame_count.push_back(count);
+        time.push_back(0.0f);
+        duration.push_back(frame_duration < 0.0f ? clip->get_frame_duration() : frame_duration);
+        return clips.size() - 1;
+    }
+
+    // Remove instance `index`, the last instance takes its index
+    void remove(size_t index)
+    {
+        if (index >= clips.size())
+            return;
+        size_t last = clips.size() - 1;
+        clips[index] = clips[last];
+        frame[index] = frame[last];
+        frame_count[index] = frame_count[last];
+        time[index] = time[last];
+        duration[index] = duration[last];
+        clips.pop_back();
+        frame.pop_back();
+        frame_count.pop_back();
+        time.pop_back();
+        duration.pop_back();
+    }
+
+    // Advance every instance by `dt` seconds, skipping frames when dt spans several
+    void update(float dt)
+    {
+        const size_t n = clips.size();
+        for (size_t i = 0; i < n; i++) time[i] += dt;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (time[i] < duration[i])
+                continue;
+            if (duration[i] <= 0.0f)
+            {
+                frame[i] = (frame[i] + 1) % frame_count[i];
+                time[i] = 0.0f;
+                continue;
+            }
+            uint32_t steps = static_cast<uint32_t>(time[i] / duration[i]);
+            time[i] -= steps * duration[i];
+            frame[i] = (frame[i] + steps) % frame_count[i];
+        }
+    }
+
+    size_t size() const { return clips.size(); }
+    uint32_t get_frame(size_t index) const { return frame[index]; }
+    void set_frame(size_t index, uint32_t f) { frame[index] = f % frame_count[index]; }
+    Glyph_view view(size_t index) const { return clips[index]->get_view(frame[index]); }
+
+    void clear()
+    {
+        clips.clear();
+        frame.clear();
+        frame_count.clear();
+        time.clear();
+        duration.clear();
+    }
+};
@@ -2,13 +2,28 @@
 #pragma once
 
 #define STB_IMAGE_IMPLEMENTATION
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "./color.hpp"
+#include "./dither.hpp"
+#include "./parallel.hpp"
 #include "./sprites.hpp"
 #include "stb_image.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace utl
 {
 
@@ -18,11 +33,25 @@ namespace utl
     int _height;
     int _channels;
     unsigned char *_pixels;
+    Dither_mode _dither = Dither_mode::NONE;
 
-  public:
   public:
     Image(const std::string &filePath) { load_image(filePath); }
 
+    // Wrap a copy of raw interleaved 8 bit pixels (1 gray, 2 gray alpha, 3 RGB or 4 RGBA channels)
+    Image(int width, int height, int channels, const unsigned char *pixels) : _width(width), _height(height), _channels(channels)
+    {
+      size_t bytes = static_cast<size_t>(width) * height * channels;
+      // stbi_image_free is free() unless STBI_FREE is overridden
+      _pixels = static_cast<unsigned char *>(std::malloc(std::max<size_t>(bytes, 1)));
+      if (!_pixels)
+        throw std::runtime_error("Failed to allocate image");
+      std::memcpy(_pixels, pixels, bytes);
+    }
+
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
     ~Image() { stbi_image_free(_pixels); }
 
     int get_width() const { return _width; }
@@ -30,6 +59,10 @@ namespace utl
     int get_channels() const { return _channels; }
     const unsigned char *get_pixels() const { return _pixels; }
 
+    // Dithering applied by convert_image_to_sprite to the character ramp and the terminal colors
+    void set_dither(Dither_mode mode) { _dither = mode; }
+    Dither_mode get_dither() const { return _dither; }
+
     char pixelToChar(int x, int y) const
     {
       int index = (y * _width + x) * _channels;
@@ -58,33 +91,243 @@ namespace utl
       return Color(r, g, b);
     }
 
-    Sprite convert_image_to_sprite()
+    // Convert the whole image, one cell per pixel, without going through pixelToChar/get_color
+    // Luminance is computed in fixed point and mapped to char_gradient through a 256 entry table,
+    // the character and color planes of the sprite are written in place.
+    // @param threads Number of threads the rows are split across, 0 to use the hardware concurrency
+    Sprite convert_image_to_sprite(unsigned threads = 0) const
     {
       size_t width = _width;
       size_t height = _height;
+      Sprite sprite(width, height);
+      if (width == 0 || height == 0)
+        return sprite;
+
+      const std::array<char, 256> lut = glyph_lut();
+      char *characters = sprite.character_data();
+      Color *colors = sprite.color_data();
+
+      for_each_band(height, band_threads(width * height, threads), [&](unsigned, size_t y0, size_t y1) { convert_rows(y0, y1, characters, colors, lut); });
+      apply_dither(sprite, threads);
+      return sprite;
+    }
+
+    // Convert the image to a `columns` x `rows` character grid, every cell being the average
+    // of the block of pixels it covers (nearest pixel when upscaling)
+    // Column sums of the block rows are accumulated once per output row, then summed per cell,
+    // so every source pixel is read once whatever the scale.
+    // @param columns Characters per row of the sprite
+    // @param rows Rows of the sprite
+    // @param threads Number of threads the output rows are split across, 0 to use the hardware concurrency
+    Sprite convert_image_to_sprite(size_t columns, size_t rows, unsigned threads = 0) const
+    {
+      if (columns == static_cast<size_t>(_width) && rows == static_cast<size_t>(_height))
+        return convert_image_to_sprite(threads);
+
+      Sprite sprite(columns, rows);
+      if (columns == 0 || rows == 0 || _width == 0 || _height == 0)
+        return sprite;
+
+      const std::array<char, 256> lut = glyph_lut();
+      char *characters = sprite.character_data();
+      Color *colors = sprite.color_data();
+
+      // First source column of every output column, plus the end of the last one
+      std::vector<size_t> x_edges(columns + 1);
+      for (size_t c = 0; c <= columns; c++) x_edges[c] = c * _width / columns;
+
+      for_each_band(rows,
+                    band_threads(static_cast<size_t>(_width) * _height, threads),
+                    [&](unsigned, size_t r0, size_t r1) { average_rows(r0, r1, columns, rows, x_edges, characters, colors, lut); });
+      apply_dither(sprite, threads);
+      return sprite;
+    }
+
+    // Largest grid of at most `max_columns` x `max_rows` characters showing the image with its aspect ratio
+    // @param cell_aspect Height of a character cell over its width
+    // @return {columns, rows}
+    std::pair<size_t, size_t> fit_cells(size_t max_columns, size_t max_rows, float cell_aspect = 2.0f) const
+    {
+      if (_width == 0 || _height == 0)
+        return {0, 0};
+      float rows_per_column = static_cast<float>(_height) / (_width * cell_aspect);
+      size_t columns = max_columns;
+      size_t rows = static_cast<size_t>(std::lround(columns * rows_per_column));
+      if (rows > max_rows)
+      {
+        rows = max_rows;
+        columns = static_cast<size_t>(std::lround(rows / rows_per_column));
+      }
+      return {std::max<size_t>(columns, 1), std::max<size_t>(rows, 1)};
+    }
+
+  private:
+    // Fixed point Rec. 601 luma, weights sum to 256
+    static constexpr int luma_r = 77;
+    static constexpr int luma_g = 150;
+    static constexpr int luma_b = 29;
+
+    static int luma(int r, int g, int b) { return (luma_r * r + luma_g * g + luma_b * b + 128) >> 8; }
 
-      std::vector<char> characters(width * height);
-      std::vector<Color> colors(width * height);
+    // Character of char_gradient for every luminance value, same rounding as pixelToChar
+    static std::array<char, 256> glyph_lut()
+    {
+      std::array<char, 256> lut;
+      for (int i = 0; i < 256; i++) lut[i] = char_gradient[std::lround(i / 255.0f * (char_gradient.size() - 1))];
+      return lut;
+    }
+
+    // Redo the quantization of a converted sprite with the dithering mode of the image
+    void apply_dither(Sprite &sprite, unsigned threads) const
+    {
+      if (_dither != Dither_mode::ORDERED)
+      {
+        dither_sprite(sprite, _dither);
+        return;
+      }
+
+      // Ordered dithering only looks at the cell itself, so it runs on the same bands as the conversion
+      size_t width = sprite.width();
+      char *characters = sprite.character_data();
+      Color *colors = sprite.color_data();
+      const std::vector<char> table = dither::ordered_glyph_table(char_gradient);
+      for_each_band(sprite.height(),
+                    band_threads(width * sprite.height(), threads),
+                    [&](unsigned, size_t y0, size_t y1)
+                    {
+                      std::vector<uint8_t> luma(width * (y1 - y0));
+                      for (size_t i = 0; i < luma.size(); i++) luma[i] = colors[y0 * width + i].luma();
+                      dither::ordered_glyphs(luma.data(), characters + y0 * width, width, y1 - y0, y0, table);
+                      dither::ordered_colors(colors + y0 * width, width, y1 - y0, y0);
+                    });
+    }
+
+    void average_rows(size_t r0,
+                      size_t r1,
+                      size_t columns,
+                      size_t rows,
+                      const std::vector<size_t> &x_edges,
+                      char *characters,
+                      Color *colors,
+                      const std::array<char, 256> &lut) const
+    {
+      const size_t width = _width;
+      const bool gray = _channels < 3;
+      // Per source column sums of the rows of the current block, RGB interleaved, 64 bit so a cell
+      // can average any number of pixels
+      std::vector<uint64_t> sums(width * 3);
+
+      for (size_t r = r0; r < r1; r++)
+      {
+        size_t y0 = r * _height / rows;
+        size_t y1 = std::max((r + 1) * _height / rows, y0 + 1);
+        std::fill(sums.begin(), sums.end(), 0);
+        for (size_t y = y0; y < y1; y++)
+        {
+          const unsigned char *src = _pixels + y * width * _channels;
+          if (gray)
+            for (size_t x = 0; x < width; x++) sums[x * 3] += src[x * _channels];
+          else
+            for (size_t x = 0; x < width; x++)
+            {
+              const unsigned char *p = src + x * _channels;
+              sums[x * 3] += p[0];
+              sums[x * 3 + 1] += p[1];
+              sums[x * 3 + 2] += p[2];
+            }
+        }
 
-      for (size_t y = 0; y < height; ++y)
+        char *ch = characters + r * columns;
+        Color *col = colors + r * columns;
+        for (size_t c = 0; c < columns; c++)
+        {
+          size_t x0 = x_edges[c];
+          size_t x1 = std::max(x_edges[c + 1], x0 + 1);
+          uint64_t sr = 0, sg = 0, sb = 0;
+          for (size_t x = x0; x < x1; x++)
+          {
+            sr += sums[x * 3];
+            sg += sums[x * 3 + 1];
+            sb += sums[x * 3 + 2];
+          }
+          uint64_t n = static_cast<uint64_t>(x1 - x0) * (y1 - y0);
+          uint8_t red = static_cast<uint8_t>((sr + n / 2) / n);
+          uint8_t green = gray ? red : static_cast<uint8_t>((sg + n / 2) / n);
+          uint8_t blue = gray ? red : static_cast<uint8_t>((sb + n / 2) / n);
+          ch[c] = lut[luma(red, green, blue)];
+          col[c] = Color(red, green, blue);
+        }
+      }
+    }
+
+    void convert_rows(size_t y0, size_t y1, char *characters, Color *colors, const std::array<char, 256> &lut) const
+    {
+      static_assert(sizeof(Color) == 4 && std::is_trivially_copyable<Color>::value, "Color is written as 4 packed bytes");
+      const size_t width = _width;
+      for (size_t y = y0; y < y1; y++)
       {
-        for (size_t x = 0; x < width; ++x)
+        const unsigned char *src = _pixels + y * width * _channels;
+        char *ch = characters + y * width;
+        Color *col = colors + y * width;
+        size_t x = 0;
+
+        if (_channels == 4)
         {
-          // Convert pixel to brightness
-          char ascii_char = pixelToChar(x, y);
+#if defined(__SSE2__)
+          // 4 pixels per iteration, alpha is forced opaque like the scalar path
+          const __m128i weights = _mm_setr_epi16(luma_r, luma_g, luma_b, 0, luma_r, luma_g, luma_b, 0);
+          const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+          const __m128i zero = _mm_setzero_si128();
+          const __m128i half = _mm_set1_epi32(128);
+          alignas(16) int32_t y4[4];
+          for (; x + 4 <= width; x += 4)
+          {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + x), _mm_or_si128(px, opaque));
 
-          // Get the original color (or grayscale it)
-          Color color = get_color(x, y);
+            // (r*wr + g*wg, b*wb) per pixel, then add the two halves
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+            __m128i sum = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+            _mm_store_si128(reinterpret_cast<__m128i *>(y4), _mm_srli_epi32(_mm_add_epi32(sum, half), 8));
 
-          // Store character and color
-          characters[y * width + x] = ascii_char;
-          colors[y * width + x] = color;  // or grayscale version of the color
+            ch[x] = lut[y4[0]];
+            ch[x + 1] = lut[y4[1]];
+            ch[x + 2] = lut[y4[2]];
+            ch[x + 3] = lut[y4[3]];
+          }
+#endif
+          for (; x < width; x++)
+          {
+            const unsigned char *p = src + x * 4;
+            ch[x] = lut[luma(p[0], p[1], p[2])];
+            col[x] = Color(p[0], p[1], p[2]);
+          }
+        }
+        else if (_channels == 3)
+        {
+          for (; x < width; x++)
+          {
+            const unsigned char *p = src + x * 3;
+            ch[x] = lut[luma(p[0], p[1], p[2])];
+            col[x] = Color(p[0], p[1], p[2]);
+          }
+        }
+        else
+        {
+          // Gray or gray + alpha
+          for (; x < width; x++)
+          {
+            unsigned char v = src[x * _channels];
+            ch[x] = lut[v];
+            col[x] = Color(v, v, v);
+          }
         }
       }
-      return Sprite(width, height, characters, colors);
     }
 
-  private:
     void load_image(const std::string &filePath)
     {
       // Load image data
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Splitting of a range into bands processed on several threads, shared by the image conversion,
+// the particle update and the density splat so they pick their thread counts the same way
+//
+//   unsigned threads = utl::band_threads(pixels, max_threads);
+//   utl::for_each_band(rows, threads, [&](unsigned band, size_t first, size_t last) { ... });
+
+namespace utl
+{
+
+  // Threads worth starting for `work` units (pixels, particles...), at most `threads`, 0 for one per core
+  // @param min_work Work a thread needs for starting it to pay off
+  inline unsigned band_threads(size_t work, unsigned threads, size_t min_work = 64 * 1024)
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, work / min_work)));
+  }
+
+  // Run fn(band, first, last) over at most `threads` bands of [0, count), band 0 on the calling thread
+  // @param align Bands start on a multiple of align, e.g. so every band but the last runs whole vectors
+  // @return The number of bands fn was called for, numbered from 0
+  template <typename Fn>
+  unsigned for_each_band(size_t count, unsigned threads, Fn fn, size_t align = 1)
+  {
+    threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+    if (threads <= 1)
+    {
+      fn(0u, size_t(0), count);
+      return 1;
+    }
+
+    std::vector<std::thread> workers;
+    size_t band = ((count + threads - 1) / threads + align - 1) / align * align;
+    unsigned bands = 1;
+    for (size_t first = band; first < count; first += band, bands++)
+      workers.emplace_back([&, bands, first] { fn(bands, first, std::min(first + band, count)); });
+    fn(0u, size_t(0), std::min(band, count));
+    for (auto &worker : workers) worker.join();
+    return bands;
+  }
+
+}  // namespace utl
@@ -1,15 +1,95 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "../dependencies/color.hpp"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary sprite format, all integers little endian
+//
+//   header : "TGSPR001" u32 width, u32 height, u32 flags, u32 char_bytes, u32 color_bytes, u32 reserved
+//   chars  : char_bytes bytes, width * height characters in row-major order
+//   colors : color_bytes bytes, width * height r, g, b triples in row-major order
+//
+// With flags & chars_rle (colors_rle) the plane is a list of runs instead,
+// u8 count (1 to 255) followed by one character (one r, g, b triple).
+namespace sprite_file
+{
+  static constexpr char magic[8] = {'T', 'G', 'S', 'P', 'R', '0', '0', '1'};
+  static constexpr size_t header_bytes = 32;
+  static constexpr uint32_t chars_rle = 1;
+  static constexpr uint32_t colors_rle = 2;
+
+  inline void put_u32(std::vector<uint8_t> &out, uint32_t v)
+  {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+  }
+
+  inline uint32_t get_u32(const uint8_t *p)
+  {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+  }
+
+  // Same color as the text format gives for the hex value r, g, b (black is transparent)
+  inline Color from_rgb(const uint8_t *p)
+  {
+    Color c(p[0], p[1], p[2]);
+    if (!(p[0] | p[1] | p[2]))
+      c.a() = 0;
+    return c;
+  }
+
+  // Run length encode `count` values of `size` bytes
+  inline std::vector<uint8_t> encode_runs(const uint8_t *values, size_t count, size_t size)
+  {
+    std::vector<uint8_t> out;
+    size_t i = 0;
+    while (i < count)
+    {
+      size_t run = 1;
+      while (i + run < count && run < 255 && std::memcmp(values + (i + run) * size, values + i * size, size) == 0) run++;
+      out.push_back(static_cast<uint8_t>(run));
+      out.insert(out.end(), values + i * size, values + (i + 1) * size);
+      i += run;
+    }
+    return out;
+  }
+
+  // Decode runs into exactly `count` values of `size` bytes
+  // @return False if the runs don't add up to `count` values
+  inline bool decode_runs(const uint8_t *in, size_t bytes, uint8_t *values, size_t count, size_t size)
+  {
+    size_t i = 0;
+    const uint8_t *end = in + bytes;
+    while (in + 1 + size <= end && i < count)
+    {
+      size_t run = *in;
+      if (run == 0 || i + run > count)
+        return false;
+      for (size_t k = 0; k < run; k++, i++) std::memcpy(values + i * size, in + 1, size);
+      in += 1 + size;
+    }
+    return i == count && in == end;
+  }
+}  // namespace sprite_file
+
 class Sprite
 {
   size_t _width;
@@ -19,7 +99,14 @@ class Sprite
 
 public:
   Sprite() = default;
-  Sprite(const std::string &filename) { load_from_file(filename); }
+  // Load a sprite in the text or binary format, see load_from_file and load_from_binary
+  Sprite(const std::string &filename)
+  {
+    if (is_binary_file(filename))
+      load_from_binary(filename);
+    else
+      load_from_file(filename);
+  }
   Sprite(size_t width, size_t height, std::vector<char> characters, std::vector<Color> colors)
       : _width(width), _height(height), _characters(characters), _colors(colors)
   {
@@ -43,6 +130,30 @@ public:
     return _characters[ny * _width + nx];
   }
 
+  // Nearest neighbour copy of the sprite resized to width x height
+  Sprite scaled(size_t width, size_t height) const
+  {
+    Sprite out(width, height);
+    if (!_width || !_height || !width || !height)
+      return out;
+    // Source texel of every destination texel center, stepped in 16.16 fixed point
+    const uint64_t step_x = (static_cast<uint64_t>(_width) << 16) / width;
+    const uint64_t step_y = (static_cast<uint64_t>(_height) << 16) / height;
+    uint64_t fy = step_y / 2;
+    for (size_t y = 0; y < height; y++, fy += step_y)
+    {
+      size_t sy = std::min<size_t>(fy >> 16, _height - 1);
+      uint64_t fx = step_x / 2;
+      for (size_t x = 0; x < width; x++, fx += step_x)
+      {
+        size_t sx = std::min<size_t>(fx >> 16, _width - 1);
+        out._characters[y * width + x] = _characters[sy * _width + sx];
+        out._colors[y * width + x] = _colors[sy * _width + sx];
+      }
+    }
+    return out;
+  }
+
   char get_char_un(float x, float y, size_t tiling_factor_width, size_t tiling_factor_height) const
   {
     float normalized_x = (static_cast<float>(x) / tiling_factor_width);
@@ -179,10 +290,179 @@ public:
 
     file.close();
   }
+  // Check if a file starts with the binary sprite magic
+  static bool is_binary_file(const std::string &filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    char head[sizeof(sprite_file::magic)] = {};
+    return file.read(head, sizeof(head)) && std::memcmp(head, sprite_file::magic, sizeof(head)) == 0;
+  }
+
+  // Save in the binary format, see sprite_file above
+  // @param compress Run length encode each plane when that makes it smaller
+  // @return True if the file was written
+  bool save_to_binary(const std::string &filename, bool compress = true) const
+  {
+    using namespace sprite_file;
+    size_t cells = _width * _height;
+    std::vector<uint8_t> chars(reinterpret_cast<const uint8_t *>(_characters.data()),
+                               reinterpret_cast<const uint8_t *>(_characters.data()) + cells);
+    std::vector<uint8_t> colors(cells * 3);
+    for (size_t i = 0; i < cells; i++)
+    {
+      colors[i * 3] = _colors[i].r();
+      colors[i * 3 + 1] = _colors[i].g();
+      colors[i * 3 + 2] = _colors[i].b();
+    }
+
+    uint32_t flags = 0;
+    if (compress)
+    {
+      std::vector<uint8_t> rle = encode_runs(chars.data(), cells, 1);
+      if (rle.size() < chars.size())
+      {
+        chars.swap(rle);
+        flags |= chars_rle;
+      }
+      rle = encode_runs(colors.data(), cells, 3);
+      if (rle.size() < colors.size())
+      {
+        colors.swap(rle);
+        flags |= colors_rle;
+      }
+    }
+
+    std::vector<uint8_t> header(magic, magic + sizeof(magic));
+    put_u32(header, static_cast<uint32_t>(_width));
+    put_u32(header, static_cast<uint32_t>(_height));
+    put_u32(header, flags);
+    put_u32(header, static_cast<uint32_t>(chars.size()));
+    put_u32(header, static_cast<uint32_t>(colors.size()));
+    put_u32(header, 0);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Unable to open sprite file for writing: " + filename << std::endl;
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(header.data()), header.size());
+    file.write(reinterpret_cast<const char *>(chars.data()), chars.size());
+    file.write(reinterpret_cast<const char *>(colors.data()), colors.size());
+    return file.good();
+  }
+
+  // Load a file in the binary format, the file is memory mapped and decoded straight into the planes
+  // @return True if the sprite was loaded, on error the sprite is left empty (0x0)
+  bool load_from_binary(const std::string &filename)
+  {
+    _width = _height = 0;
+    _characters.clear();
+    _colors.clear();
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      std::cerr << "Error: Unable to open sprite file: " + filename << std::endl;
+      return false;
+    }
+    struct stat info;
+    size_t size = ::fstat(fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    void *map = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+      std::cerr << "Error: Unable to map sprite file: " + filename << std::endl;
+      return false;
+    }
+    bool ok = decode_binary(static_cast<const uint8_t *>(map), size);
+    ::munmap(map, size);
+#else
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Unable to open sprite file: " + filename << std::endl;
+      return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bool ok = decode_binary(data.data(), data.size());
+#endif
+    if (!ok)
+    {
+      std::cerr << "Error: Corrupt binary sprite file: " + filename << std::endl;
+      _width = _height = 0;
+      _characters.clear();
+      _colors.clear();
+    }
+    return ok;
+  }
+
   size_t width() const { return _width; }
   size_t height() const { return _height; }
 
   std::vector<char> characters() const { return _characters; }
   std::vector<Color> colors() const { return _colors; }
+
+  // Direct access to the character and color planes, width() * height() entries in row-major order
+  char *character_data() { return _characters.data(); }
+  const char *character_data() const { return _characters.data(); }
+  Color *color_data() { return _colors.data(); }
+  const Color *color_data() const { return _colors.data(); }
   void set_colors(const std::vector<Color> &colors) { _colors = colors; }
+
+private:
+  bool decode_binary(const uint8_t *data, size_t size)
+  {
+    using namespace sprite_file;
+    if (size < header_bytes || std::memcmp(data, magic, sizeof(magic)) != 0)
+      return false;
+    size_t width = get_u32(data + 8);
+    size_t height = get_u32(data + 12);
+    uint32_t flags = get_u32(data + 16);
+    size_t char_bytes = get_u32(data + 20);
+    size_t color_bytes = get_u32(data + 24);
+    if (width != 0 && height > std::numeric_limits<size_t>::max() / width)
+      return false;
+    size_t cells = width * height;
+    if (header_bytes + char_bytes + color_bytes > size)
+      return false;
+    // Cells the planes can hold, checked before sizing the sprite from the header so a corrupt
+    // one can't ask for more memory than the file describes: raw planes hold exactly one value
+    // per cell, a run is a count byte and a value and covers at most 255 cells
+    size_t char_cells = (flags & chars_rle) ? char_bytes / 2 * 255 : char_bytes;
+    size_t color_cells = (flags & colors_rle) ? color_bytes / 4 * 255 : color_bytes / 3;
+    if (cells > char_cells || cells > color_cells)
+      return false;
+    if (!(flags & chars_rle) && char_bytes != cells)
+      return false;
+    if (!(flags & colors_rle) && color_bytes != cells * 3)
+      return false;
+
+    const uint8_t *chars = data + header_bytes;
+    const uint8_t *colors = chars + char_bytes;
+    _characters.resize(cells);
+    if (flags & chars_rle)
+    {
+      if (!decode_runs(chars, char_bytes, reinterpret_cast<uint8_t *>(_characters.data()), cells, 1))
+        return false;
+    }
+    else
+      std::memcpy(_characters.data(), chars, cells);
+
+    _colors.resize(cells);
+    if (flags & colors_rle)
+    {
+      std::vector<uint8_t> rgb(cells * 3);
+      if (!decode_runs(colors, color_bytes, rgb.data(), cells, 3))
+        return false;
+      for (size_t i = 0; i < cells; i++) _colors[i] = from_rgb(&rgb[i * 3]);
+    }
+    else
+      for (size_t i = 0; i < cells; i++) _colors[i] = from_rgb(colors + i * 3);
+
+    _width = width;
+    _height = height;
+    return true;
+  }
 };
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./image.hpp"
+#include "./sprites.hpp"
+
+namespace utl
+{
+
+  /*!
+   * \class Video_stream
+   *
+   * \brief Streams numbered image files as sprites, decoded ahead of playback by worker threads.
+   *
+   * At most `prefetch` frames are decoded but not yet presented, so memory stays constant
+   * whatever the length of the video and the first frame is available as soon as it is decoded.
+   *
+   *   utl::Video_stream video("../assets/Frames/frame_%04d.png", 999);
+   *   Sprite frame;
+   *   while (video.next(frame))
+   *     renderer.draw_sprite({0, 0}, frame);
+   */
+  class Video_stream
+  {
+    std::string _pattern;        //>> printf style path of the frames, given the frame number
+    int _first;                  //>> Number of the first frame
+    int _count;                  //>> Number of frames
+    size_t _prefetch;            //>> Max frames decoded ahead of the presenter
+    size_t _columns;             //>> Width of the decoded sprites, 0 for the image width
+    size_t _rows;                //>> Height of the decoded sprites, 0 for the image height
+    std::vector<Sprite> _slots;  //>> Ring of decoded frames, frame i lives in slot i % _prefetch
+    std::vector<char> _ready;    //>> Whether the slot holds its decoded frame
+
+    std::mutex _mutex;
+    std::condition_variable _can_decode;
+    std::condition_variable _can_present;
+    int _next_decode = 0;   //>> Next frame a worker will pick up
+    int _next_present = 0;  //>> Next frame next() will return
+    bool _stop = false;
+    std::vector<std::thread> _workers;
+
+  public:
+    // @param pattern printf style path of the frames, e.g. "frames/frame_%04d.png"
+    // @param frame_count Number of frames
+    // @param prefetch Max frames decoded ahead of playback
+    // @param threads Decoder threads, 0 to use the hardware concurrency
+    // @param first_frame Number of the first frame in the file names
+    // @param columns, rows Size of the decoded sprites, frames are area averaged down to it (0, 0 keeps the image size)
+    Video_stream(const std::string &pattern,
+                 int frame_count,
+                 size_t prefetch = 16,
+                 unsigned threads = 0,
+                 int first_frame = 1,
+                 size_t columns = 0,
+                 size_t rows = 0)
+        : _pattern(pattern),
+          _first(first_frame),
+          _count(std::max(frame_count, 0)),
+          _prefetch(std::max<size_t>(prefetch, 1)),
+          _columns(columns),
+          _rows(rows)
+    {
+      _slots.resize(_prefetch);
+      _ready.resize(_prefetch, 0);
+      if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = std::min<unsigned>(threads, _prefetch);
+      for (unsigned i = 0; i < threads; i++) _workers.emplace_back(&Video_stream::decode_loop, this);
+    }
+
+    Video_stream(const Video_stream &) = delete;
+    Video_stream &operator=(const Video_stream &) = delete;
+
+    ~Video_stream()
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _can_decode.notify_all();
+      for (auto &worker : _workers) worker.join();
+    }
+
+    // Get the next frame, waiting for it to be decoded if needed
+    // @param frame Receives the frame, a 0x0 sprite if the file could not be decoded
+    // @return False once every frame has been returned
+    bool next(Sprite &frame)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (_next_present >= _count)
+        return false;
+      size_t slot = _next_present % _prefetch;
+      _can_present.wait(lock, [&] { return _ready[slot] != 0; });
+      frame = std::move(_slots[slot]);
+      _ready[slot] = 0;
+      _next_present++;
+      lock.unlock();
+      _can_decode.notify_all();
+      return true;
+    }
+
+    int frame_count() const { return _count; }
+    size_t prefetch() const { return _prefetch; }
+
+    // Number of decoded frames waiting to be presented
+    size_t buffered()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      size_t n = 0;
+      for (char r : _ready) n += r;
+      return n;
+    }
+
+  private:
+    std::string frame_path(int index) const
+    {
+      std::vector<char> path(_pattern.size() + 32);
+      std::snprintf(path.data(), path.size(), _pattern.c_str(), _first + index);
+      return path.data();
+    }
+
+    void decode_loop()
+    {
+      while (true)
+      {
+        int index;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _can_decode.wait(lock, [&] { return _stop || _next_decode >= _count || _next_decode < _next_present + (int)_prefetch; });
+          if (_stop || _next_decode >= _count)
+            return;
+          index = _next_decode++;
+        }
+
+        Sprite sprite(0, 0);
+        try
+        {
+          Image image(frame_path(index));
+          // The workers already run in parallel, convert each frame on a single thread
+          if (_columns && _rows)
+            sprite = image.convert_image_to_sprite(_columns, _rows, 1);
+          else
+            sprite = image.convert_image_to_sprite(1);
+        }
+        catch (const std::exception &e)
+        {
+          std::cerr << "Error: " << e.what() << std::endl;
+        }
+
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          size_t slot = index % _prefetch;
+          _slots[slot] = std::move(sprite);
+          _ready[slot] = 1;
+        }
+        _can_present.notify_one();
+      }
+    }
+  };
+
+}  // namespace utl
@@ -4,48 +4,35 @@
 #include <cmath>
 #include <iostream>
 
-#include "dependencies/image.hpp"
+#include "dependencies/video.hpp"
 #include "renderer2D/ascii.hpp"
+#include "time/frame_rate.hpp"
 
-std::vector<Sprite> load_video_frames(const std::string &frame_path_pattern, int total_frames)
+// Frames are decoded by background threads a few frames ahead of playback,
+// so playback starts right away and memory doesn't grow with the length of the video
+void play_video(utl::Video_stream &video, Renderer &renderer, int fps)
 {
-  std::vector<Sprite> frames;
-  frames.reserve(total_frames);
-  std::cout << "Loading " << total_frames << " frames..." << std::endl;
-  for (int i = 1; i <= total_frames; ++i)
+  Frame_rate frame_rate(fps);
+  Sprite sprite;
+  while (video.next(sprite))
   {
-    std::ostringstream frame_path;
-    frame_path << frame_path_pattern << std::setfill('0') << std::setw(4) << i << ".png";
-
-    utl::Image image(frame_path.str());               // Assuming utl::Image can load images
-    Sprite sprite = image.convert_image_to_sprite();  // Assuming Sprite is a class that can hold image data
-    frames.emplace_back(sprite);
-  }
-  std::cout << "Loaded! " << std::endl;
-  return frames;
-}
-
-void play_video(const std::vector<Sprite> &sprites, Renderer &renderer, int fps)
-{
-  int delay = 1000 / fps;  // Delay between frames in milliseconds
-
-  for (const auto &sprite : sprites)
-  {
-    renderer.empty();                                               // Clear the screen or buffer
-    renderer.reset_screen();                                        // Set the cursor to the top left corner
-    renderer.draw_sprite({0, 0}, sprite);                           // Draw the sprite at the desired position
-    renderer.print();                                               // Display the frame
-    std::this_thread::sleep_for(std::chrono::milliseconds(delay));  // Wait for the next frame
+    frame_rate.start_frame();
+    renderer.empty();                      // Clear the screen or buffer
+    renderer.reset_screen();               // Set the cursor to the top left corner
+    renderer.draw_sprite({0, 0}, sprite);  // Draw the sprite at the desired position
+    renderer.print();                      // Display the frame
+    frame_rate.end_frame();                // Wait for the next frame
   }
 }
 
 int main()
 {
-  auto frames = load_video_frames("./assets/Frames/frame_", 999);
-  size_t width = frames[0].width();
-  size_t height = frames[0].height();
-  Renderer r(width / 2, height);
-  play_video(frames, r, 24);
+  // Area average the frames down to a grid that fits the terminal, characters being about twice as tall as wide
+  utl::Image first("./assets/Frames/frame_0001.png");
+  auto [columns, rows] = first.fit_cells(160, 60);
+  utl::Video_stream video("./assets/Frames/frame_%04d.png", 999, 16, 0, 1, columns, rows);
+  Renderer r((columns + 1) / 2, rows);
+  play_video(video, r, 24);
   std::cin.get();
   return 0;
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -11,6 +13,8 @@
 
 #define L_GEBRA_IMPLEMENTATION
 
+#include "../Camera/camera2D.hpp"
+#include "../Fractal/fractal.hpp"
 #include "../dependencies/color.hpp"
 #include "../dependencies/font.hpp"
 #include "../dependencies/glyph.hpp"
@@ -19,8 +23,16 @@
 #include "../dependencies/sprites.hpp"
 #include "../dependencies/ui_elements.hpp"
 #include "../l_gebra/l_gebra.hpp"
+#include "../time/profiler.hpp"
 #include "../window/window.hpp"
 #include "basic_units.hpp"
+#include "density.hpp"
+#include "recorder.hpp"
+#include "sprite_atlas.hpp"
+#include "subcell.hpp"
+#include "text_cache.hpp"
+#include "texture.hpp"
+#include "tilemap.hpp"
 
 #define ANSII_BG_RESET "\033[49m"
 
@@ -38,9 +50,13 @@ static char anti_aliasing[2][2] = {{'`', '^'}, {'-', 'c'}};
  */
 class Renderer
 {
-  std::shared_ptr<Buffer> _buffer;      //>> The buffer to draw to
-  Color _bg_color = Color(0x00000000);  //>> The background color of the renderer
-  Window _window;                       //>> The window object
+  std::shared_ptr<Buffer> _buffer;            //>> The buffer to draw to
+  Color _bg_color = Color(0x00000000);        //>> The background color of the renderer
+  Window _window;                             //>> The window object
+  std::unique_ptr<Frame_recorder> _recorder;  //>> Records presented frames, null when not recording
+  Subcell_canvas _canvas;                     //>> Dots drawn with draw_dot, printed when the sub cell mode isn't NONE
+  Text_cache _text_cache;                     //>> Runs of text already rasterized by draw_text_with_font
+  bool _retained = false;                     //>> Only the dirty spans of the buffer are printed
 
 public:
   // Constructors
@@ -48,6 +64,10 @@ public:
   Renderer(size_t width, size_t height);
   Renderer(std::shared_ptr<Buffer> buffer);
   Renderer(size_t width, size_t height, Color bg_color);
+  // Headless renderer, frames go to `sink` instead of the terminal
+  // @param sink Output_sink::NONE, MEMORY or FILE (TERMINAL behaves like the other constructors)
+  // @param path The output file for Output_sink::FILE
+  Renderer(size_t width, size_t height, Output_sink sink, const std::string &path = "");
   // Destructor
   ~Renderer();
   // Getters
@@ -55,6 +75,7 @@ public:
   //Get the smart pointer to the buffer
   //@return The smart pointer to the buffer
   const Buffer &get_buffer() const;
+  Buffer &get_buffer() { return *_buffer; }
 
   //Get the width of the buffer
   //@return The width of the buffer
@@ -64,6 +85,11 @@ public:
   //@return The height of the buffer
   size_t get_height() const;
 
+  //Get the window the frames are written to
+  //@return The window, holds the output sink and its byte counters
+  const Window &get_window() const { return _window; }
+  Window &get_window() { return _window; }
+
   // Initialize the renderer
   // This function initializes the terminal window for rendering
   void Init();
@@ -91,6 +117,17 @@ public:
   // @return True if the point was drawn, false otherwise
   bool draw_point(const Point &point);
 
+  // Draw many points in one call, e.g. the arrays of a Particle_system
+  // The positions are truncated to cells, points off the buffer are skipped
+  // @param xs, ys The positions of the points
+  // @param count The number of points
+  // @param c The character to draw
+  // @param colors The color of every point
+  void draw_points(const float *xs, const float *ys, size_t count, char c, const Color *colors);
+
+  // Draw many points in one call, all of the same color
+  void draw_points(const float *xs, const float *ys, size_t count, char c, Color color = Color(utl::Color_codes::WHITE));
+
   // Draw a half point
   // @param point The point to draw
   // @param c The character to draw
@@ -303,6 +340,10 @@ public:
   void draw_text_with_shadow(utl::Vec<int, 2> start, const std::string &text, Color color, Color shadow_color, const Font &font,
                              int shadow_offset_x = 1, int shadow_offset_y = 1);
 
+  // Set how many text runs draw_text_with_font keeps rasterized, 0 disables the cache
+  void set_text_cache_capacity(size_t runs) { _text_cache.set_capacity(runs); }
+  const Text_cache &get_text_cache() const { return _text_cache; }
+
   // Load a font
   // @param font_path The path to the font file
   // @return The font object
@@ -319,11 +360,77 @@ public:
   // @param color The color of the glyph, default is white
   void draw_glyph(utl::Vec<int, 2> start_pos, const Glyph &glyph, Color color = utl::Color_codes::WHITE);
 
+  // Draw a glyph view, e.g. a frame of an Animated_glyph or a Glyph_animator instance, without copying it
+  // @param start_pos The starting position of the glyph
+  // @param glyph The view of the glyph
+  // @param color The color of the glyph, default is white
+  void draw_glyph(utl::Vec<int, 2> start_pos, Glyph_view glyph, Color color = utl::Color_codes::WHITE);
+
   // Draw a sprite
   // @param start_pos The starting position of the sprite
   // @param sprite The sprite object to draw
   void draw_sprite(const utl::Vec<int, 2> start_pos, const Sprite &sprite);
 
+  // Draw a sprite stored in an atlas, rows are clipped to the buffer and copied whole
+  // @param atlas The atlas holding the sprite
+  // @param id The id returned by Sprite_atlas::add
+  // @param start_pos The top left cell of the sprite
+  // @param flags Sprite_flags, SPRITE_FLIP_X and SPRITE_FLIP_Y
+  void draw_sprite(const Sprite_atlas &atlas, uint32_t id, utl::Vec<int, 2> start_pos, uint32_t flags = SPRITE_NONE);
+
+  // Sprites added to the atlas with a transparency key only write their opaque runs
+
+  // Fill a rectangle of cells with a sprite sampled through an affine mapping
+  // @param start The top-left corner of the rectangle
+  // @param width, height The size of the rectangle in cells
+  // @param sprite The texture
+  // @param mapping Texel of every character of the buffer, see Texture_mapping::affine
+  // @param wrap What is sampled outside of the sprite, tiled backgrounds use REPEAT
+  void draw_textured_rect(utl::Vec<int, 2> start,
+                          int width,
+                          int height,
+                          const Sprite &sprite,
+                          const Texture_mapping &mapping,
+                          Texture_wrap wrap = Texture_wrap::REPEAT);
+
+  // Draw the chunks of a tilemap that are on screen
+  // @param map The tilemap
+  // @param origin The cell the top left corner of tile (0, 0) lands on
+  void draw_tilemap(Tilemap &map, utl::Vec<int, 2> origin);
+
+  // Draw a tilemap scrolled by a camera, world units being cells
+  // Tiles keep their size, the zoom and rotation of the camera only move the origin
+  void draw_tilemap(Tilemap &map, const Camera2D &camera);
+
+  // Draw the cells of a density buffer that were hit, empty cells are left untouched
+  // Weights are mapped to [0, 1] on a log scale up to the largest one, then to a character of
+  // char_gradient and a color of the gradient
+  // @param density The accumulated weights, its top left cell lands on the top left of the buffer
+  // @param gradient Colors from the least to the most dense cells
+  void draw_density(const Density_buffer &density, const Gradient &gradient);
+
+  // Draw the cells of a computed fractal, its top left cell on the top left of the buffer
+  // @param fractal The fractal, see Escape_time_fractal::compute
+  // @param gradient Colors of the escaping cells, by smooth iteration count over max iterations
+  // @param ch The character to draw
+  // @param inside The color of the cells in the set
+  void draw_fractal(const Escape_time_fractal &fractal,
+                    const Gradient &gradient,
+                    char ch = '#',
+                    Color inside = Color(utl::Color_codes::BLACK));
+
+  // Draw a sprite scaled and rotated around its center, cells outside of it are left untouched
+  // @param center The cell the center of the sprite lands on
+  // @param sprite The sprite object to draw
+  // @param scale The scale factor, 1 draws one character per texel
+  // @param angle The rotation in radians
+  void draw_sprite_transformed(utl::Vec<float, 2> center, const Sprite &sprite, float scale, float angle = 0.0f);
+
+  // Draw a batch of atlas sprites in order, later ones on top
+  // @param atlas The atlas holding the sprites
+  // @param draws The sprites to draw
+  void draw_sprites(const Sprite_atlas &atlas, const std::vector<Sprite_draw> &draws);
+
   // Draw a button
   // @param button The button object to draw
   void draw_button(std::shared_ptr<Button> button);
@@ -339,6 +446,40 @@ public:
   // Draw a buffer
   void print();
 
+  // Retained mode, the app keeps the buffer between frames and only redraws what changes instead
+  // of calling empty() every frame, print() then only sends the cells written since the last
+  // print (the dirty spans of the buffer) to the terminal
+  // Switching it on marks the whole buffer dirty so the next print is complete.
+  void set_retained(bool retained);
+  bool is_retained() const { return _retained; }
+
+  // Print half block or braille dots instead of plain cells, see subcell.hpp
+  // The canvas is sized to the buffer, text drawn in the buffer is printed over the dots.
+  // @param mode Subcell_mode::NONE goes back to printing the buffer alone
+  void set_subcell_mode(Subcell_mode mode) { _canvas.resize(mode, _buffer->width, _buffer->height); }
+  Subcell_mode get_subcell_mode() const { return _canvas.mode(); }
+
+  // Get the dot canvas, get_canvas().width() x get_canvas().height() dots
+  Subcell_canvas &get_canvas() { return _canvas; }
+  const Subcell_canvas &get_canvas() const { return _canvas; }
+
+  // Draw a dot in sub cell mode
+  // @param dot The position in dots, not cells
+  // @param color The color of the dot
+  // @return True if the dot was drawn, false otherwise
+  bool draw_dot(utl::Vec<int, 2> dot, Color color = Color(utl::Color_codes::WHITE)) { return _canvas.set(dot.x(), dot.y(), color); }
+
+  // Start recording every printed frame to a delta compressed stream, see recorder.hpp
+  // @param path The file to record to
+  // @return True if the file could be opened
+  bool start_recording(const std::string &path);
+
+  // Stop recording and close the stream
+  void stop_recording() { _recorder.reset(); }
+
+  // Check if printed frames are being recorded
+  bool is_recording() const { return _recorder != nullptr; }
+
   // Create a buffer
   // @param width The width of the buffer
   // @param height The height of the buffer
@@ -379,6 +520,21 @@ public:
   static void show_cursor();
 
 private:
+  // Sample `sprite` through `mapping` into the cells [x0, x1) x [y0, y1), clipped to the buffer
+  template <Texture_wrap wrap>
+  void blit_textured(int x0, int y0, int x1, int y1, const Sprite &sprite, const Texture_mapping &mapping);
+
+  // Fill a rectangle one row at a time, span(j, i0, count, colors) writes the gradient colors of
+  // cells i0 .. i0 + count of row j, the rows and cells being clipped to the buffer beforehand
+  template <typename Span>
+  void fill_gradient_rect(utl::Vec<int, 2> start, int width, int height, char ch, Span span);
+
+  // Lay out `text` with `font` and call plot(x, y, ch1, ch2) for every cell it covers
+  // @return How far right the text reaches from start.x, it wraps when start.x + reach >= wrap_width
+  template <typename Plot>
+  static int layout_text(utl::Vec<int, 2> start, const std::string &text, const Font &font, int wrap_width, Plot plot);
+  static Text_cache::Run rasterize_text(const std::string &text, Color color, const Font &font);
+
   void draw_circle_octants(const utl::Vec<int, 2> &center, int x, int y, char ch, Color color);
 };
 
@@ -399,6 +555,11 @@ Renderer::Renderer(size_t width, size_t height, Color bg_color) : _buffer(std::m
 {
   Init();
 }
+Renderer::Renderer(size_t width, size_t height, Output_sink sink, const std::string &path)
+    : _buffer(std::make_shared<Buffer>(width, height)), _window(sink, path)
+{
+  Init();
+}
 Renderer::~Renderer() { _window.cleanup_terminal(); }
 const Buffer &Renderer::get_buffer() const { return *_buffer; }
 
@@ -439,6 +600,35 @@ bool Renderer::draw_point(const Point &point)
   return i;
 }
 
+void Renderer::draw_points(const float *xs, const float *ys, size_t count, char c, const Color *colors)
+{
+  PROFILE_SCOPE("raster");
+  const float width = static_cast<float>(_buffer->width), height = static_cast<float>(_buffer->height);
+  for (size_t i = 0; i < count; i++)
+  {
+    // Written so NaN positions fail the test too
+    if (!(xs[i] >= 0.0f && xs[i] < width && ys[i] >= 0.0f && ys[i] < height))
+      continue;
+    size_t x = static_cast<size_t>(xs[i]), y = static_cast<size_t>(ys[i]);
+    _buffer->data[y * _buffer->width + x].set(c, colors[i]);
+    _buffer->mark_dirty(x, y);
+  }
+}
+
+void Renderer::draw_points(const float *xs, const float *ys, size_t count, char c, Color color)
+{
+  PROFILE_SCOPE("raster");
+  const float width = static_cast<float>(_buffer->width), height = static_cast<float>(_buffer->height);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (!(xs[i] >= 0.0f && xs[i] < width && ys[i] >= 0.0f && ys[i] < height))
+      continue;
+    size_t x = static_cast<size_t>(xs[i]), y = static_cast<size_t>(ys[i]);
+    _buffer->data[y * _buffer->width + x].set(c, color);
+    _buffer->mark_dirty(x, y);
+  }
+}
+
 bool Renderer::draw_half_point(utl::Vec<int, 2> point, char c, bool left, Color color)
 {
   _buffer->set_absolute(point, c, left, color);
@@ -458,6 +648,7 @@ void Renderer::draw_fill_circle(const Circle &circle)
 
 void Renderer::draw_line(utl::Vec<int, 2> start, utl::Vec<int, 2> end, char c, Color color)
 {
+  PROFILE_SCOPE("raster");
   // Anti-aliasing will depend upon left or right of the pixel and top or bottom of the pixel
   int x1 = start[0], y1 = start[1];
   int x2 = end[0], y2 = end[1];
@@ -511,18 +702,50 @@ void Renderer::draw_fill_rectangle(const Rectangle &rectangle)
   draw_fill_rectangle(rectangle.get_top_left(), rectangle.get_width(), rectangle.get_height(), rectangle.get_char(), rectangle.get_color());
 }
 
+template <typename Span>
+void Renderer::fill_gradient_rect(utl::Vec<int, 2> start, int width, int height, char ch, Span span)
+{
+  int i0 = std::max(0, -start.x()), i1 = std::min(width, (int)_buffer->width - start.x());
+  int j0 = std::max(0, -start.y()), j1 = std::min(height, (int)_buffer->height - start.y());
+  if (i0 >= i1 || j0 >= j1)
+    return;
+  std::vector<Color> colors(i1 - i0);
+  for (int j = j0; j < j1; j++)
+  {
+    span(j, i0, i1 - i0, colors.data());
+    Pixel *row = &_buffer->data[(start.y() + j) * _buffer->width + start.x() + i0];
+    for (int i = 0; i < i1 - i0; i++) row[i].set(ch, colors[i]);
+    _buffer->mark_row_dirty(start.y() + j, start.x() + i0, start.x() + i1);
+  }
+}
 void Renderer::draw_rect_linear_gradient(utl::Vec<int, 2> start, int width, int height, char ch, Gradient &gradient, bool horizontal)
 {
-  for (int i = 0; i < (horizontal ? width : height); i++)
+  PROFILE_SCOPE("raster");
+  if (horizontal)
   {
-    float t = static_cast<float>(i) / (horizontal ? width : height);
-    Color color = gradient.get_color_at(t);
-    for (int j = 0; j < (horizontal ? height : width); j++)
-      if (horizontal)
-        _buffer->set({start.x() + i, start.y() + j}, ch, color);
-      else
-        _buffer->set({start.x() + j, start.y() + i}, ch, color);
+    // Every row is the same span of colors
+    const float dt = 1.0f / width;
+    std::vector<Color> colors;
+    fill_gradient_rect(start,
+                       width,
+                       height,
+                       ch,
+                       [&](int, int i0, int count, Color *out)
+                       {
+                         if (colors.empty())
+                         {
+                           colors.resize(count);
+                           gradient.sample_span(i0 * dt, dt, count, colors.data());
+                         }
+                         std::copy(colors.begin(), colors.end(), out);
+                       });
   }
+  else
+    fill_gradient_rect(start,
+                       width,
+                       height,
+                       ch,
+                       [&](int j, int, int count, Color *out) { std::fill(out, out + count, gradient.sample(static_cast<float>(j) / height)); });
 }
 std::pair<float, float> Renderer::rotate_point(float x, float y, float angle)
 {
@@ -534,57 +757,29 @@ std::pair<float, float> Renderer::rotate_point(float x, float y, float angle)
 }
 void Renderer::draw_rect_rotated_gradient(utl::Vec<int, 2> start, int width, int height, char ch, Gradient &gradient, float angle)
 {
-  // Iterate over each pixel in the rectangle
-  for (int i = 0; i < width; ++i)
-  {
-    for (int j = 0; j < height; ++j)
-    {
-      // Calculate the pixel position relative to the start of the rectangle
-      float px = start.x() + i;
-      float py = start.y() + j;
-
-      // Rotate the pixel position to align with the gradient direction
-      auto [rotated_x, rotated_y] = rotate_point(px - start.x() - width / 2.0f, py - start.y() - height / 2.0f, -angle);
-
-      // Map rotated coordinates to gradient progress
-      float t = (rotated_x + width / 2.0f) / width;
-      // Get the color at the normalized position
-      Color color = gradient.get_color_at(t);
-
-      // Set the pixel in the buffer
-      _buffer->set({start.x() + i, start.y() + j}, ch, color);
-    }
-  }
+  PROFILE_SCOPE("raster");
+  // The cell position rotated by -angle around the center of the rectangle, mapped to [0, 1]:
+  //   t = ((i - width / 2) * cos + (j - height / 2) * sin + width / 2) / width
+  // is linear in i and j, so it is stepped by constant deltas instead of rotating every cell
+  const float dt_i = std::cos(angle) / width;
+  const float dt_j = std::sin(angle) / width;
+  const float t0 = 0.5f - (width / 2.0f) * dt_i - (height / 2.0f) * dt_j;
+  fill_gradient_rect(
+      start, width, height, ch, [&](int j, int i0, int count, Color *out) { gradient.sample_span(t0 + j * dt_j + i0 * dt_i, dt_i, count, out); });
 }
 void Renderer::draw_rect_radial_gradient(utl::Vec<int, 2> start, int width, int height, char ch, Gradient &gradient)
 {
+  PROFILE_SCOPE("raster");
   float half_width = width / 2.0f;
   float half_height = height / 2.0f;
-  // Calculate the center of the rectangle
-  float centerX = start.x() + half_width;
-  float centerY = start.y() + half_height;
-
-  float max_distance = std::sqrt(half_width * half_width + half_height * half_height);
-  // Iterate over each pixel in the rectangle
-  for (int i = 0; i < width; ++i)
-  {
-    for (int j = 0; j < height; ++j)
-    {
-      // Calculate the distance of the current pixel from the center
-      float distanceX = start.x() + i - centerX;
-      float distanceY = start.y() + j - centerY;
-      float distance = std::sqrt(distanceX * distanceX + distanceY * distanceY);
-
-      // Normalize the distance to get a value between 0 and 1
-      float t = distance / max_distance;
-
-      // Get the color at the normalized distance
-      Color color = gradient.get_color_at(t);
-
-      // Set the pixel in the buffer
-      _buffer->set({start.x() + i, start.y() + j}, ch, color);
-    }
-  }
+  // Distance from the center normalized by the distance to the corners
+  float inv_max_distance = 1.0f / std::sqrt(half_width * half_width + half_height * half_height);
+  fill_gradient_rect(start,
+                     width,
+                     height,
+                     ch,
+                     [&](int j, int i0, int count, Color *out)
+                     { gradient.sample_radial_span(i0 - half_width, j - half_height, inv_max_distance, count, out); });
 }
 void Renderer::draw_triangle(const Triangle &triangle)
 {
@@ -609,6 +804,7 @@ void Renderer::draw_fill_antialias_triangle(const Triangle &triangle)
 }
 void Renderer::draw_text_constraints(utl::Vec<int, 2> start, const std::string &text, Color color, size_t width, size_t height)
 {
+  PROFILE_SCOPE("raster");
   int x = start.x();
   int y = start.y();
   for (size_t i = 0; i < text.size() / 2; i++)
@@ -637,29 +833,301 @@ void Renderer::draw_button(std::shared_ptr<Button> button)
 }
 void Renderer::draw_sprite(const utl::Vec<int, 2> start_pos, const Sprite &sprite)
 {
-  auto characters = sprite.characters();
-  auto colors = sprite.colors();
-  size_t width = sprite.width();
-  int x1 = 0, x2 = 0;
-  for (size_t y = 0; y < sprite.height(); y++)
-    for (size_t x = 0; x < sprite.width() / 2; x++)
+  PROFILE_SCOPE("raster");
+  const char *characters = sprite.character_data();
+  const Color *colors = sprite.color_data();
+  const int width = sprite.width();
+  const int height = sprite.height();
+  const int cells = (width + 1) / 2;
+
+  // Clip to the buffer once instead of per cell
+  int x0 = std::max(0, -start_pos.x()), x1 = std::min(cells, (int)_buffer->width - start_pos.x());
+  int y0 = std::max(0, -start_pos.y()), y1 = std::min(height, (int)_buffer->height - start_pos.y());
+  for (int y = y0; y < y1; y++)
+  {
+    Pixel *out = &_buffer->data[(start_pos.y() + y) * _buffer->width + start_pos.x()];
+    _buffer->mark_row_dirty(start_pos.y() + y, start_pos.x() + x0, start_pos.x() + x1);
+    const char *ch = characters + y * width;
+    const Color *col = colors + y * width;
+    for (int x = x0; x < x1; x++)
+    {
+      if (2 * x + 1 < width)
+        out[x] = Pixel(ch[2 * x], ch[2 * x + 1], col[2 * x], col[2 * x + 1]);
+      else
+        out[x] = Pixel(ch[2 * x], ' ', col[2 * x], Color());
+    }
+  }
+}
+
+void Renderer::draw_sprite(const Sprite_atlas &atlas, uint32_t id, utl::Vec<int, 2> start_pos, uint32_t flags)
+{
+  PROFILE_SCOPE("raster");
+  if (!atlas.contains(id))
+    return;
+  const Sprite_atlas::Entry &entry = atlas.entry(id);
+  const int width = entry.width;
+  const int height = entry.height;
+  const int chars = 2 * width - entry.padded;
+
+  int x0 = std::max(0, -start_pos.x()), x1 = std::min(width, (int)_buffer->width - start_pos.x());
+  int y0 = std::max(0, -start_pos.y()), y1 = std::min(height, (int)_buffer->height - start_pos.y());
+  if (x0 >= x1)
+    return;
+  for (int y = y0; y < y1; y++) _buffer->mark_row_dirty(start_pos.y() + y, start_pos.x() + x0, start_pos.x() + x1);
+
+  if (entry.transparent)
+  {
+    const Sprite_atlas::Run *runs = atlas.runs(id);
+    for (size_t i = 0; i < entry.run_count; i++)
+    {
+      const Sprite_atlas::Run &run = runs[i];
+      int y = flags & SPRITE_FLIP_Y ? height - 1 - (int)run.y : (int)run.y;
+      if (y < y0 || y >= y1)
+        continue;
+      const Pixel *src = atlas.row(id, run.y);
+      Pixel *out = &_buffer->data[(start_pos.y() + y) * _buffer->width + start_pos.x()];
+      if (!(flags & SPRITE_FLIP_X))
+      {
+        int first = std::max((int)run.x, x0), last = std::min((int)(run.x + run.length), x1);
+        if (first >= last)
+          continue;
+        if (run.half == 0)
+          std::memcpy(out + first, src + first, (last - first) * sizeof(Pixel));
+        else if (run.half == 1)
+        {
+          out[first].set_char(src[first]._ch1, out[first]._ch2);
+          out[first]._color1 = src[first]._color1;
+        }
+        else
+        {
+          out[first].set_char(out[first]._ch1, src[first]._ch2);
+          out[first]._color2 = src[first]._color2;
+        }
+        continue;
+      }
+      // Mirrored a character at a time, character c of the row lands on chars - 1 - c so an odd
+      // width keeps its padding on the trailing side
+      int first = 2 * run.x + (run.half == 2), last = 2 * (run.x + run.length) - (run.half == 1);
+      for (int c = first; c < last; c++)
+      {
+        int d = chars - 1 - c, x = d / 2;
+        if (x < x0 || x >= x1)
+          continue;
+        const Pixel &p = src[c / 2];
+        char ch = c % 2 ? p._ch2 : p._ch1;
+        Color color = c % 2 ? p._color2 : p._color1;
+        if (d % 2)
+        {
+          out[x].set_char(out[x]._ch1, ch);
+          out[x]._color2 = color;
+        }
+        else
+        {
+          out[x].set_char(ch, out[x]._ch2);
+          out[x]._color1 = color;
+        }
+      }
+    }
+    return;
+  }
+
+  for (int y = y0; y < y1; y++)
+  {
+    const Pixel *src = atlas.row(id, flags & SPRITE_FLIP_Y ? height - 1 - y : y);
+    Pixel *out = &_buffer->data[(start_pos.y() + y) * _buffer->width + start_pos.x()];
+    if (!(flags & SPRITE_FLIP_X))
+    {
+      std::memcpy(out + x0, src + x0, (x1 - x0) * sizeof(Pixel));
+      continue;
+    }
+    // Mirrored, the cells are read backwards and the two characters of each cell swapped
+    if (!entry.padded)
+    {
+      for (int x = x0; x < x1; x++)
+      {
+        const Pixel &p = src[width - 1 - x];
+        out[x] = Pixel(p._ch2, p._ch1, p._color2, p._color1);
+      }
+      continue;
+    }
+    // An odd width shifts the mirrored row by a character, so every cell takes its characters
+    // from two neighbouring source cells and the padding stays in the last cell
+    for (int x = x0; x < x1; x++)
+    {
+      const Pixel &a = src[width - 1 - x];
+      if (x + 1 < width)
+      {
+        const Pixel &b = src[width - 2 - x];
+        out[x] = Pixel(a._ch1, b._ch2, a._color1, b._color2);
+      }
+      else
+        out[x] = Pixel(a._ch1, ' ', a._color1, Color());
+    }
+  }
+}
+
+void Renderer::draw_sprites(const Sprite_atlas &atlas, const std::vector<Sprite_draw> &draws)
+{
+  for (const Sprite_draw &draw : draws) draw_sprite(atlas, draw.id, draw.position, draw.flags);
+}
+
+template <Texture_wrap wrap>
+void Renderer::blit_textured(int x0, int y0, int x1, int y1, const Sprite &sprite, const Texture_mapping &mapping)
+{
+  const int64_t width = sprite.width(), height = sprite.height();
+  if (!width || !height)
+    return;
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, (int)_buffer->width);
+  y0 = std::max(y0, 0);
+  y1 = std::min(y1, (int)_buffer->height);
+  const char *characters = sprite.character_data();
+  const Color *colors = sprite.color_data();
+
+  // Texel coordinates in 16.16 fixed point, stepped by a constant delta per character
+  const double one = 65536.0;
+  const int64_t du = std::llround(mapping.du_dx * one), dv = std::llround(mapping.dv_dx * one);
+  // Index of the texel at (fu, fv), -1 outside of the sprite when clipping
+  auto texel = [&](int64_t fu, int64_t fv) -> int64_t
+  {
+    int64_t u = fu >> 16, v = fv >> 16;
+    if constexpr (wrap == Texture_wrap::CLIP)
+    {
+      if (u < 0 || u >= width || v < 0 || v >= height)
+        return -1;
+    }
+    else if constexpr (wrap == Texture_wrap::CLAMP)
+    {
+      u = std::clamp<int64_t>(u, 0, width - 1);
+      v = std::clamp<int64_t>(v, 0, height - 1);
+    }
+    else
+    {
+      if (u < 0 || u >= width)
+        u = ((u % width) + width) % width;
+      if (v < 0 || v >= height)
+        v = ((v % height) + height) % height;
+    }
+    return v * width + u;
+  };
+
+  for (int y = y0; y < y1; y++)
+  {
+    int64_t fu = static_cast<int64_t>(std::floor((mapping.u0 + 2.0 * x0 * mapping.du_dx + (double)y * mapping.du_dy) * one));
+    int64_t fv = static_cast<int64_t>(std::floor((mapping.v0 + 2.0 * x0 * mapping.dv_dx + (double)y * mapping.dv_dy) * one));
+    Pixel *out = &_buffer->data[y * _buffer->width];
+    _buffer->mark_row_dirty(y, x0, x1);
+    for (int x = x0; x < x1; x++)
+    {
+      int64_t first = texel(fu, fv);
+      int64_t second = texel(fu + du, fv + dv);
+      fu += 2 * du;
+      fv += 2 * dv;
+      if (first >= 0 && second >= 0)
+        out[x] = Pixel(characters[first], characters[second], colors[first], colors[second]);
+      else if (first >= 0)
+      {
+        out[x].set_char(characters[first], out[x]._ch2);
+        out[x]._color1 = colors[first];
+      }
+      else if (second >= 0)
+      {
+        out[x].set_char(out[x]._ch1, characters[second]);
+        out[x]._color2 = colors[second];
+      }
+    }
+  }
+}
+
+void Renderer::draw_textured_rect(
+    utl::Vec<int, 2> start, int width, int height, const Sprite &sprite, const Texture_mapping &mapping, Texture_wrap wrap)
+{
+  PROFILE_SCOPE("raster");
+  int x1 = start.x() + width, y1 = start.y() + height;
+  if (wrap == Texture_wrap::CLIP)
+    blit_textured<Texture_wrap::CLIP>(start.x(), start.y(), x1, y1, sprite, mapping);
+  else if (wrap == Texture_wrap::CLAMP)
+    blit_textured<Texture_wrap::CLAMP>(start.x(), start.y(), x1, y1, sprite, mapping);
+  else
+    blit_textured<Texture_wrap::REPEAT>(start.x(), start.y(), x1, y1, sprite, mapping);
+}
+
+void Renderer::draw_tilemap(Tilemap &map, utl::Vec<int, 2> origin)
+{
+  PROFILE_SCOPE("raster");
+  map.draw(*_buffer, origin);
+}
+
+void Renderer::draw_tilemap(Tilemap &map, const Camera2D &camera)
+{
+  const Camera_transform &transform = camera.get_transform();
+  draw_tilemap(map, utl::Vec<int, 2>{(int)std::floor(transform.x), (int)std::floor(transform.y)});
+}
+
+void Renderer::draw_fractal(const Escape_time_fractal &fractal, const Gradient &gradient, char ch, Color inside)
+{
+  PROFILE_SCOPE("raster");
+  const float inv_max = 1.0f / fractal.max_iterations();
+  const Color *lut = gradient.get_lut().data();
+  const size_t width = std::min(fractal.width(), _buffer->width);
+  const size_t height = std::min(fractal.height(), _buffer->height);
+  for (size_t y = 0; y < height; y++)
+  {
+    const float *row = fractal.values() + y * fractal.width();
+    Pixel *out = &_buffer->data[y * _buffer->width];
+    for (size_t x = 0; x < width; x++)
+      out[x].set(ch, row[x] == Escape_time_fractal::inside ? inside : lut[Gradient::lut_index(row[x] * inv_max)]);
+    _buffer->mark_row_dirty(y, 0, width);
+  }
+}
+
+void Renderer::draw_density(const Density_buffer &density, const Gradient &gradient)
+{
+  PROFILE_SCOPE("raster");
+  const float max = density.max();
+  if (!(max > 0.0f))
+    return;
+  const float inv_log_max = 1.0f / std::log1p(max);
+  const float glyphs = static_cast<float>(char_gradient.size() - 1);
+  const Color *lut = gradient.get_lut().data();
+  const size_t width = std::min(density.width(), _buffer->width);
+  const size_t height = std::min(density.height(), _buffer->height);
+  for (size_t y = 0; y < height; y++)
+  {
+    const float *row = density.data() + y * density.width();
+    Pixel *out = &_buffer->data[y * _buffer->width];
+    size_t first = width, last = 0;
+    for (size_t x = 0; x < width; x++)
     {
-      x1 = 2 * x;
-      x2 = 2 * x + 1;
-      _buffer->set({(int)(start_pos.x() + x), (int)(start_pos.y() + y)},
-                   characters[y * width + x1],
-                   characters[y * width + x2],
-                   colors[y * width + x1],
-                   colors[y * width + x2]);
+      if (!(row[x] > 0.0f))
+        continue;
+      float t = std::log1p(row[x]) * inv_log_max;
+      out[x].set(char_gradient[static_cast<size_t>(t * glyphs + 0.5f)], lut[Gradient::lut_index(t)]);
+      first = std::min(first, x);
+      last = x + 1;
     }
-  if (sprite.width() % 2)
-    for (size_t y = 0; y < sprite.height(); y++)
-      _buffer->set({(int)(start_pos.x() + x2), (int)(start_pos.y() + y)},
-                   characters[y * width + (width - 1)],
-                   ' ',
-                   colors[y * width + width - 1],
-                   Color());
+    _buffer->mark_row_dirty(y, first, last);
+  }
+}
+
+void Renderer::draw_sprite_transformed(utl::Vec<float, 2> center, const Sprite &sprite, float scale, float angle)
+{
+  PROFILE_SCOPE("raster");
+  if (scale <= 0.0f)
+    return;
+  const float aspect = Texture_mapping::char_aspect;
+  Texture_mapping mapping = Texture_mapping::affine(center, {sprite.width() / 2.0f, sprite.height() / 2.0f}, scale, angle);
+
+  // Bounding box of the rotated sprite, in characters horizontally and rows vertically
+  float c = std::abs(std::cos(angle)), s = std::abs(std::sin(angle));
+  float half_width = sprite.width() / 2.0f * scale, half_height = sprite.height() / 2.0f * aspect * scale;
+  float extent_x = c * half_width + s * half_height;
+  float extent_y = (s * half_width + c * half_height) / aspect;
+  int x0 = (int)std::floor((2 * center.x() - extent_x) / 2), x1 = (int)std::ceil((2 * center.x() + extent_x) / 2) + 1;
+  int y0 = (int)std::floor(center.y() - extent_y), y1 = (int)std::ceil(center.y() + extent_y) + 1;
+  blit_textured<Texture_wrap::CLIP>(x0, y0, x1, y1, sprite, mapping);
 }
+
 void Renderer::draw_textbox(std::shared_ptr<Textbox> textbox)
 {
   utl::Vec<int, 2> pos = textbox->position();
@@ -693,6 +1161,7 @@ void Renderer::draw_slider(std::shared_ptr<Slider> slider)
 }
 void Renderer::draw_anti_aliased_line(utl::Vec<int, 2> start, utl::Vec<int, 2> end, Color color)
 {
+  PROFILE_SCOPE("raster");
   int x0 = start.x();
   int y0 = start.y();
   int x1 = end.x();
@@ -803,6 +1272,7 @@ void Renderer::draw_triangle(utl::Vec<int, 2> a, utl::Vec<int, 2> b, utl::Vec<in
 
 void Renderer::draw_fill_circle(utl::Vec<int, 2> center, int radius, char ch, Color color)
 {
+  PROFILE_SCOPE("raster");
   // Define the anti-aliasing shades
   char anti_aliasing[] = {' ', '.', ':', '-', '=', '+', '*', '#', '%', '@'};
   int shades = sizeof(anti_aliasing) / sizeof(anti_aliasing[0]);
@@ -837,6 +1307,7 @@ void Renderer::draw_fill_circle(utl::Vec<int, 2> center, int radius, char ch, Co
 
 void Renderer::draw_circle(utl::Vec<int, 2> center, int radius, char ch, Color color)
 {
+  PROFILE_SCOPE("raster");
   int x = radius;
   int y = 0;
   int radiusError = 1 - x;
@@ -893,6 +1364,7 @@ void Renderer::draw_rectangle(utl::Vec<int, 2> point, int width, int height, cha
 
 void Renderer::draw_fill_rectangle(utl::Vec<int, 2> point, int width, int height, char ch, Color color)
 {
+  PROFILE_SCOPE("raster");
   utl::Vec<int, 2> end = point + utl::Vec<int, 2>{width, height};
   for (int y = point.y(); y <= end.y(); ++y)
     for (int x = point.x(); x <= end.x(); ++x) _buffer->set({x, y}, ch, color);
@@ -900,6 +1372,7 @@ void Renderer::draw_fill_rectangle(utl::Vec<int, 2> point, int width, int height
 
 void Renderer::draw_fill_triangle(utl::Vec<int, 2> a, utl::Vec<int, 2> b, utl::Vec<int, 2> c, char ch, Color color)
 {
+  PROFILE_SCOPE("raster");
   // Sort the vertices by y-coordinate
   if (a.y() > b.y())
     std::swap(a, b);
@@ -1007,6 +1480,7 @@ void Renderer::draw_fill_antialias_triangle(utl::Vec<int, 2> a, utl::Vec<int, 2>
 void Renderer::draw_arc(utl::Vec<int, 2> center, int radius, char ch, float end_angle, float start_angle /* = 0.0f */,
                         Color color /* = WHITE */)
 {
+  PROFILE_SCOPE("raster");
   float step = 1.0f / radius;  // Step size for angle increment
   float angle = start_angle;
 
@@ -1043,6 +1517,7 @@ void Renderer::draw_arc(utl::Vec<int, 2> center, int radius, char ch, float end_
 
 void Renderer::draw_text(utl::Vec<int, 2> start, const std::string &text, Color color)
 {
+  PROFILE_SCOPE("raster");
   int x = start.x();
   int y = start.y();
   for (size_t i = 0; i < text.size() / 2; i++)
@@ -1055,47 +1530,112 @@ void Renderer::draw_text(utl::Vec<int, 2> start, const std::string &text, Color
     _buffer->set({x, y}, text[(int)(text.length() - 1)], ' ', color);
 }
 
-void Renderer::draw_text_with_font(utl::Vec<int, 2> start, const std::string &text, Color color, const Font &font)
+template <typename Plot>
+int Renderer::layout_text(utl::Vec<int, 2> start, const std::string &text, const Font &font, int wrap_width, Plot plot)
 {
   int x = start.x();
   int y = start.y();
-  int px = 0;
-  int py = 0;
+  int reach = 0;
   for (char ch : text)
   {
-    if (font.get_glyph(ch).is_empty())
+    const Font_glyph *found = font.find_glyph(ch);
+    // Glyphs without rows take no room
+    if (found && found->is_empty())
       continue;
-    const Font_glyph &glyph = font.get_glyph(ch);
-    const std::vector<std::string> &lines = glyph.get_lines();
+    Glyph_view glyph = font.get_bitmap(ch);
+    if (!found)
+    {
+      // Missing characters are drawn with the default glyph
+      const Font_glyph &fallback = font.get_glyph(ch);
+      glyph = {fallback.get_lines()[0].data(), fallback.get_width(), 1};
+    }
     // Render each line of the glyph
     // if width is odd then we need to draw last character, no biggies
-    for (size_t j = 0; j < lines.size(); j++)
+    for (int j = 0; j < glyph.height; j++)
     {
-      for (size_t k = 0; k < lines[j].size() / 2; k++)
-      {
-        px = x + k;
-        py = y + j;
-        _buffer->set({px, py}, lines[j][2 * k], lines[j][2 * k + 1], color);
-      }
-      if (lines.size() % 2 == 1)
-      {
-        px = x + lines[0].size() / 2;
-        py = y + j;
-        _buffer->set({px, py}, lines[j][lines[j].size() - 1], ' ', color);
-      }
+      const char *line = glyph.row(j);
+      for (int k = 0; k < glyph.width / 2; k++) plot(x + k, y + j, line[2 * k], line[2 * k + 1]);
+      if (glyph.width % 2 == 1)
+        plot(x + glyph.width / 2, y + j, line[glyph.width - 1], ' ');
     }
-    x += glyph.get_width() / 2 + 1;
-    if (x + glyph.get_width() + 1 >= static_cast<int>(_buffer->width))
+    x += glyph.width / 2 + 1;
+    reach = std::max(reach, x - start.x() + glyph.width + 1);
+    if (x + glyph.width + 1 >= wrap_width)
     {
       x = start.x();
-      y += (glyph.get_height() + 1);
+      y += (glyph.height + 1);
+    }
+  }
+  return reach;
+}
+
+Text_cache::Run Renderer::rasterize_text(const std::string &text, Color color, const Font &font)
+{
+  struct Cell
+  {
+    int x, y;
+    char ch1, ch2;
+  };
+  std::vector<Cell> cells;
+  Text_cache::Run run;
+  run.reach = layout_text({0, 0},
+                          text,
+                          font,
+                          std::numeric_limits<int>::max(),
+                          [&](int x, int y, char ch1, char ch2)
+                          {
+                            cells.push_back({x, y, ch1, ch2});
+                            run.width = std::max(run.width, (size_t)x + 1);
+                            run.height = std::max(run.height, (size_t)y + 1);
+                          });
+  run.cells.resize(run.width * run.height);
+  run.mask.resize(run.width * run.height, 0);
+  for (const Cell &c : cells)
+  {
+    run.cells[c.y * run.width + c.x] = Pixel(c.ch1, c.ch2, color);
+    run.mask[c.y * run.width + c.x] = 1;
+  }
+  return run;
+}
+
+void Renderer::draw_text_with_font(utl::Vec<int, 2> start, const std::string &text, Color color, const Font &font)
+{
+  PROFILE_SCOPE("raster");
+  const int wrap_width = static_cast<int>(_buffer->width);
+  if (_text_cache.capacity())
+  {
+    std::string key = Text_cache::make_key(text, font.get_id(), color);
+    const Text_cache::Run *run = _text_cache.find(key);
+    if (!run)
+      run = _text_cache.insert(key, rasterize_text(text, color, font));
+    // Runs are cached without wrapping, text that wraps here is laid out again below
+    if (start.x() + run->reach < wrap_width)
+    {
+      for (size_t j = 0; j < run->height; j++)
+      {
+        int y = start.y() + (int)j;
+        if (y < 0 || y >= (int)_buffer->height)
+          continue;
+        for (size_t k = 0; k < run->width; k++)
+        {
+          int x = start.x() + (int)k;
+          if (run->mask[j * run->width + k] && x >= 0 && x < wrap_width)
+          {
+            _buffer->data[y * _buffer->width + x] = run->cells[j * run->width + k];
+            _buffer->mark_dirty(x, y);
+          }
+        }
+      }
+      return;
     }
   }
+  layout_text(start, text, font, wrap_width, [&](int x, int y, char ch1, char ch2) { _buffer->set({x, y}, ch1, ch2, color); });
 }
 
 void Renderer::draw_text_with_shadow(utl::Vec<int, 2> start, const std::string &text, Color color, Color shadow_color, const Font &font,
                                      int shadow_offset_x /* = 1 */, int shadow_offset_y /* = 1 */)
 {
+  PROFILE_SCOPE("raster");
   int x = start.x();
   int y = start.y();
 
@@ -1104,9 +1644,9 @@ void Renderer::draw_text_with_shadow(utl::Vec<int, 2> start, const std::string &
   // Draw the shadow first
   for (char ch : text)
   {
-    if (font.get_glyph(ch).is_empty())
-      continue;
     const Font_glyph &glyph = font.get_glyph(ch);
+    if (glyph.is_empty())
+      continue;
     const std::vector<std::string> &lines = glyph.get_lines();
 
     for (size_t j = 0; j < lines.size(); j++)
@@ -1134,9 +1674,9 @@ void Renderer::draw_text_with_shadow(utl::Vec<int, 2> start, const std::string &
   // Draw the actual text
   for (char ch : text)
   {
-    if (font.get_glyph(ch).is_empty())
-      continue;
     const Font_glyph &glyph = font.get_glyph(ch);
+    if (glyph.is_empty())
+      continue;
     const std::vector<std::string> &lines = glyph.get_lines();
     // Render each line of the glyph
     for (size_t j = 0; j < lines.size(); j++)
@@ -1176,28 +1716,78 @@ Font Renderer::load_font(const std::string &font_path)
 void Renderer::print()
 {
   std::string print_buffer;
+  {
+    // Closed before the write and the recording, so they show up in their own zones
+    PROFILE_SCOPE("encode");
 
-  // Set the background color if it is not transparent
-  print_buffer += _bg_color.to_ansii_bg_str();
+    // Set the background color if it is not transparent
+    print_buffer += _bg_color.to_ansii_bg_str();
 
-  for (size_t y = 0; y < _buffer->height; y++)
-  {
-    for (size_t x = 0; x < _buffer->width; x++)
+    if (_canvas.mode() != Subcell_mode::NONE)
+      _canvas.encode(*_buffer, _bg_color, print_buffer);
+    else if (_retained)
     {
-      print_buffer += (*_buffer)(x, y)._color1.to_ansii_fg_str();
-      print_buffer += (*_buffer)(x, y)._ch1;
-      // Add the foreground color and character for _ch2
-      print_buffer += (*_buffer)(x, y)._color2.to_ansii_fg_str();
-      print_buffer += (*_buffer)(x, y)._ch2;
+      // Only the dirty span of each row, placed with a cursor move
+      for (size_t y = 0; y < _buffer->height; y++)
+      {
+        const Dirty_span &span = _buffer->dirty[y];
+        if (span.begin == span.end)
+          continue;
+        print_buffer += "\033[" + std::to_string(y + 1) + ";" + std::to_string(2 * span.begin + 1) + "H";
+        for (size_t x = span.begin; x < span.end; x++)
+        {
+          print_buffer += (*_buffer)(x, y)._color1.to_ansii_fg_str();
+          print_buffer += (*_buffer)(x, y)._ch1;
+          print_buffer += (*_buffer)(x, y)._color2.to_ansii_fg_str();
+          print_buffer += (*_buffer)(x, y)._ch2;
+        }
+      }
     }
-    // Add a newline at the end of each row
-    print_buffer += '\n';
+    else
+    {
+      for (size_t y = 0; y < _buffer->height; y++)
+      {
+        for (size_t x = 0; x < _buffer->width; x++)
+        {
+          print_buffer += (*_buffer)(x, y)._color1.to_ansii_fg_str();
+          print_buffer += (*_buffer)(x, y)._ch1;
+          // Add the foreground color and character for _ch2
+          print_buffer += (*_buffer)(x, y)._color2.to_ansii_fg_str();
+          print_buffer += (*_buffer)(x, y)._ch2;
+        }
+        // Add a newline at the end of each row
+        print_buffer += '\n';
+      }
+    }
+    // Reset background color at the end of the entire buffer
+    print_buffer += ANSII_BG_RESET;
   }
-  // Reset background color at the end of the entire buffer
-  print_buffer += ANSII_BG_RESET;
 
   // Draw the buffer to the window
   _window.draw(print_buffer);
+
+  // Only the text layer fits in the recording format
+  if (_recorder)
+  {
+    PROFILE_SCOPE("record");
+    _recorder->record(*_buffer, _bg_color);
+  }
+  _buffer->clear_dirty();
+}
+
+void Renderer::set_retained(bool retained)
+{
+  _retained = retained;
+  if (retained)
+    _buffer->mark_all_dirty();
+}
+
+bool Renderer::start_recording(const std::string &path)
+{
+  _recorder = std::make_unique<Frame_recorder>(path);
+  if (!_recorder->is_open())
+    _recorder.reset();
+  return _recorder != nullptr;
 }
 
 Glyph Renderer::load_glyph(const std::string &glyph_path)
@@ -1210,35 +1800,38 @@ Glyph Renderer::load_glyph(const std::string &glyph_path)
 
 void Renderer::draw_glyph(utl::Vec<int, 2> start_pos, const Glyph &glyph, Color color /* WHITE */)
 {
-  auto lines = glyph.get_data();
-  int px = 0;
-  int py = 0;
+  PROFILE_SCOPE("raster");
+  const auto &lines = glyph.get_data();
   int x = start_pos.x();
   int y = start_pos.y();
-  // if (y % 2 != 0) y--;
-  // for (auto &row : data)
-  // {
-  //     for (auto &ch : row)
-  //     {
-  //       std::cout << ch;
-  //     }
-  //     std::cout << '\n';
-  //
-  // }
   for (size_t j = 0; j < lines.size(); j++)
   {
-    for (size_t k = 0; k < lines[j].size(); k += 2)
-    {
-      px = x + k / 2;
-      py = y + j;
-      _buffer->set({px, py}, lines[j][k], lines[j][k + 1], color);
-    }
+    const std::string &line = lines[j];
+    for (size_t k = 0; k < line.size(); k += 2)
+      _buffer->set({x + (int)k / 2, y + (int)j}, line[k], k + 1 < line.size() ? line[k + 1] : ' ', color);
+  }
+}
+
+void Renderer::draw_glyph(utl::Vec<int, 2> start_pos, Glyph_view glyph, Color color /* WHITE */)
+{
+  PROFILE_SCOPE("raster");
+  int x = start_pos.x();
+  int y = start_pos.y();
+  for (int j = 0; j < glyph.height; j++)
+  {
+    const char *line = glyph.row(j);
+    for (int k = 0; k < glyph.width; k += 2)
+      _buffer->set({x + k / 2, y + j}, line[k], k + 1 < glyph.width ? line[k + 1] : ' ', color);
   }
 }
 
 std::shared_ptr<Buffer> Renderer::create_buffer(size_t width, size_t height) { return std::make_shared<Buffer>(width, height); }
 
-void Renderer::empty() { _buffer->fill(' ', Color()); }
+void Renderer::empty()
+{
+  _buffer->fill(' ', Color());
+  _canvas.clear();
+}
 
 void Renderer::clear_screen() { std::cout << "\033[2J"; }
 
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #define L_GEBRA_IMPLEMENTATION
 #include "../dependencies/color.hpp"
@@ -107,13 +109,23 @@ public:
   bool is_empty() const { return _is_empty; }
 };
 
+// Cells [begin, end) of a row of a Buffer, begin == end when nothing in the row changed
+struct Dirty_span
+{
+  size_t begin;
+  size_t end;
+};
+
 // Buffer class represents a 2D buffer of Pixels
+// Every set and fill grows the dirty span of the rows it writes, code writing `data` directly
+// has to call mark_dirty or mark_row_dirty itself
 class Buffer
 {
 public:
   std::unique_ptr<Pixel[]> data;  // Unique pointer to an array of Pixels
   size_t width;                   // Width of the buffer
   size_t height;                  // Height of the buffer
+  std::vector<Dirty_span> dirty;  // Per row, the cells written since the last clear_dirty()
 
   // Default constructor initializes with no data
   Buffer() : data(nullptr), width(0), height(0) {}
@@ -121,7 +133,8 @@ public:
   // Constructor with width and height, initializes all pixels as empty
   // @param width Width of the buffer
   // @param height Height of the buffer
-  Buffer(size_t width, size_t height) : data(std::make_unique<Pixel[]>(width * height)), width(width), height(height)
+  Buffer(size_t width, size_t height)
+      : data(std::make_unique<Pixel[]>(width * height)), width(width), height(height), dirty(height, Dirty_span{0, width})
   {
     for (size_t i = 0; i < width * height; ++i) data[i] = Pixel(' ', Color());
   }
@@ -132,14 +145,15 @@ public:
   // @param fill The character to fill the buffer with
   // @param color The color to use for all pixels
   Buffer(size_t width, size_t height, char fill, Color color)
-      : data(std::make_unique<Pixel[]>(width * height)), width(width), height(height)
+      : data(std::make_unique<Pixel[]>(width * height)), width(width), height(height), dirty(height, Dirty_span{0, width})
   {
     for (size_t i = 0; i < width * height; ++i) data[i] = Pixel(fill, color);
   }
 
   // Copy constructor
   // @param other The buffer to copy from
-  Buffer(const Buffer &other) : data(std::make_unique<Pixel[]>(other.width * other.height)), width(other.width), height(other.height)
+  Buffer(const Buffer &other)
+      : data(std::make_unique<Pixel[]>(other.width * other.height)), width(other.width), height(other.height), dirty(other.dirty)
   {
     std::copy(other.data.get(), other.data.get() + width * height, data.get());
   }
@@ -154,11 +168,49 @@ public:
       width = other.width;
       height = other.height;
       data = std::make_unique<Pixel[]>(width * height);
+      dirty = other.dirty;
       std::copy(other.data.get(), other.data.get() + width * height, data.get());
     }
     return *this;
   }
 
+  // Grow the dirty span of row y over cell x
+  void mark_dirty(size_t x, size_t y)
+  {
+    Dirty_span &span = dirty[y];
+    if (span.begin == span.end)
+      span = {x, x + 1};
+    else
+    {
+      span.begin = std::min(span.begin, x);
+      span.end = std::max(span.end, x + 1);
+    }
+  }
+
+  // Grow the dirty span of row y over the cells [begin, end)
+  void mark_row_dirty(size_t y, size_t begin, size_t end)
+  {
+    if (begin >= end)
+      return;
+    Dirty_span &span = dirty[y];
+    if (span.begin == span.end)
+      span = {begin, end};
+    else
+    {
+      span.begin = std::min(span.begin, begin);
+      span.end = std::max(span.end, end);
+    }
+  }
+
+  void mark_all_dirty() { std::fill(dirty.begin(), dirty.end(), Dirty_span{0, width}); }
+  void clear_dirty() { std::fill(dirty.begin(), dirty.end(), Dirty_span{0, 0}); }
+
+  // Whether any cell was written since the last clear_dirty()
+  bool is_dirty() const
+  {
+    return std::any_of(dirty.begin(), dirty.end(), [](const Dirty_span &span) { return span.begin != span.end; });
+  }
+
   // Set a pixel in the buffer at a specific point
   // @param point The position to set the pixel
   // @param ch The character for the pixel
@@ -168,7 +220,10 @@ public:
     int x = point.x();
     int y = point.y();
     if (x >= 0 && static_cast<size_t>(x) < width && y >= 0 && static_cast<size_t>(y) < height)
+    {
       data[y * width + x].set(ch, color);
+      mark_dirty(x, y);
+    }
   }
 
   // Set a pixel with two characters and a single color
@@ -181,7 +236,10 @@ public:
     int x = point.x();
     int y = point.y();
     if (x >= 0 && static_cast<size_t>(x) < width && y >= 0 && static_cast<size_t>(y) < height)
+    {
       data[y * width + x] = Pixel(ch1, ch2, color);
+      mark_dirty(x, y);
+    }
   }
 
   // Set a pixel with two characters and two colors
@@ -195,7 +253,10 @@ public:
     int x = point.x();
     int y = point.y();
     if (x >= 0 && static_cast<size_t>(x) < width && y >= 0 && static_cast<size_t>(y) < height)
+    {
       data[y * width + x] = Pixel(ch1, ch2, color1, color2);
+      mark_dirty(x, y);
+    }
   }
 
   void set_absolute(utl::Vec<int, 2> point, char ch, bool left, Color color)
@@ -214,13 +275,14 @@ public:
         data[y * width + x]._ch2 = ch;
         data[y * width + x]._color2 = color;
       }
+      mark_dirty(x, y);
     }
   }
 
   // Access a pixel using (x, y) coordinates
   // @param x The x-coordinate of the pixel
   // @param y The y-coordinate of the pixel
-  // @return A reference to the Pixel at (x, y)
+  // @return A reference to the Pixel at (x, y), writes through it are not tracked, see mark_dirty
   Pixel &operator()(size_t x, size_t y) { return data[y * width + x]; }
 
   // Access a pixel using (x, y) coordinates (const version)
@@ -235,11 +297,13 @@ public:
   void fill(char ch, Color color)
   {
     for (size_t i = 0; i < width * height; ++i) data[i] = Pixel(ch, color);
+    mark_all_dirty();
   }
 
   // Clear the buffer (set all pixels to empty)
   void clear()
   {
     for (size_t i = 0; i < width * height; ++i) data[i] = Pixel(' ', Color());
+    mark_all_dirty();
   }
 };
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "../dependencies/parallel.hpp"
+
+/*!
+ * \class Density_buffer
+ *
+ * \brief Weight accumulated per cell by any number of points, e.g. the particles of a
+ * Particle_system, so a cell hit by many particles shows how many instead of only the last one.
+ * Renderer::draw_density turns it into characters and colors in one pass over the cells, so
+ * presenting costs the same whatever the number of particles.
+ *
+ * Large batches are splatted on several threads, every thread into its own copy of the cells,
+ * and the copies are summed into the buffer afterwards.
+ *
+ *   Density_buffer density(renderer.get_width(), renderer.get_height());
+ *   density.clear();
+ *   density.splat(particles.x(), particles.y(), particles.size());
+ *   renderer.draw_density(density, fire);
+ */
+class Density_buffer
+{
+  size_t _width = 0;
+  size_t _height = 0;
+  std::vector<float> _cells;                  //>> Accumulated weight, row-major
+  std::vector<std::vector<float>> _partials;  //>> Cells of the extra threads of the last splat
+  unsigned _threads;                          //>> Max threads of splat, 0 for one per core
+  float _max = 0.0f;                          //>> Largest weight, updated by every splat
+
+public:
+  // @param width, height Size in cells, usually the size of the renderer
+  // @param threads Max threads splat runs on, 0 for one per core
+  Density_buffer(size_t width, size_t height, unsigned threads = 0) : _threads(threads) { resize(width, height); }
+
+  void resize(size_t width, size_t height)
+  {
+    _width = width;
+    _height = height;
+    _cells.assign(width * height, 0.0f);
+    _partials.clear();
+    _max = 0.0f;
+  }
+
+  // Reset every cell to 0, call it before splatting a new frame
+  void clear()
+  {
+    std::fill(_cells.begin(), _cells.end(), 0.0f);
+    _max = 0.0f;
+  }
+
+  // Add the weight of `count` points to the cells they land on, positions are truncated to cells
+  // and points off the buffer are skipped
+  // @param weights Weight of every point, nullptr to count every point as 1
+  void splat(const float *xs, const float *ys, size_t count, const float *weights = nullptr)
+  {
+    // A thread is only worth it when it has many more points to splat than cells to sum up
+    unsigned threads = utl::band_threads(count, _threads, 64 * 1024 + 4 * _cells.size());
+    if (threads > 1)
+      _partials.resize(threads - 1);
+    unsigned bands = utl::for_each_band(count,
+                                        threads,
+                                        [&](unsigned band, size_t first, size_t last)
+                                        {
+                                          if (band == 0)
+                                          {
+                                            accumulate(_cells.data(), xs, ys, weights, first, last);
+                                            return;
+                                          }
+                                          std::vector<float> &cells = _partials[band - 1];
+                                          cells.assign(_cells.size(), 0.0f);
+                                          accumulate(cells.data(), xs, ys, weights, first, last);
+                                        });
+    for (unsigned band = 1; band < bands; band++)
+      for (size_t i = 0; i < _cells.size(); i++) _cells[i] += _partials[band - 1][i];
+    // Kept up to date here rather than on demand, so max() stays a plain read when several
+    // threads draw the same buffer
+    _max = _cells.empty() ? 0.0f : *std::max_element(_cells.begin(), _cells.end());
+  }
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  float at(size_t x, size_t y) const { return _cells[y * _width + x]; }
+  const float *data() const { return _cells.data(); }
+
+  // Largest weight of a cell
+  float max() const { return _max; }
+
+  void set_threads(unsigned threads) { _threads = threads; }
+
+private:
+  void accumulate(float *cells, const float *xs, const float *ys, const float *weights, size_t first, size_t last) const
+  {
+    const float width = static_cast<float>(_width), height = static_cast<float>(_height);
+    for (size_t i = first; i < last; i++)
+    {
+      // Written so NaN positions fail the test too
+      if (!(xs[i] >= 0.0f && xs[i] < width && ys[i] >= 0.0f && ys[i] < height))
+        continue;
+      cells[static_cast<size_t>(ys[i]) * _width + static_cast<size_t>(xs[i])] += weights ? weights[i] : 1.0f;
+    }
+  }
+};
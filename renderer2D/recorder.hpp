@@ -0,0 +1,309 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "basic_units.hpp"
+
+// Recorded session format, all integers little endian, append only so it can be streamed
+// and a truncated file still replays up to its last complete frame.
+//
+//   header : "TGREC001" u32 width, u32 height
+//   frame  : u32 frame_magic ("FRM0"), u64 timestamp_us, u32 bg_rgba, u32 run_count, runs...
+//   run    : u32 first_cell, u32 cell_count, cells...
+//   cell   : u8 ch1, u8 ch2, u8 r1, g1, b1, a1, u8 r2, g2, b2, a2
+//
+// A frame only holds the cells that changed since the previous frame (the first frame is
+// diffed against a blank buffer), as runs of consecutive cells in row-major order.
+
+namespace frame_stream
+{
+  static constexpr char file_magic[8] = {'T', 'G', 'R', 'E', 'C', '0', '0', '1'};
+  static constexpr uint32_t frame_magic = 0x304D5246;  // "FRM0"
+  static constexpr size_t cell_bytes = 10;
+  // Unchanged gaps up to this many cells are folded into the surrounding run, a new run costs 8 bytes
+  static constexpr size_t max_gap = 1;
+
+  inline void put_u32(std::vector<uint8_t> &out, uint32_t v)
+  {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+  }
+
+  inline void put_u64(std::vector<uint8_t> &out, uint64_t v)
+  {
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+  }
+
+  inline uint32_t get_u32(const uint8_t *p)
+  {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+           static_cast<uint32_t>(p[3]) << 24;
+  }
+
+  inline uint64_t get_u64(const uint8_t *p) { return static_cast<uint64_t>(get_u32(p)) | static_cast<uint64_t>(get_u32(p + 4)) << 32; }
+
+  inline uint32_t pack_color(const Color &c) { return c.r() | c.g() << 8 | c.b() << 16 | static_cast<uint32_t>(c.a()) << 24; }
+
+  inline Color unpack_color(uint32_t v)
+  {
+    Color c(static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8), static_cast<uint8_t>(v >> 16));
+    c.a() = static_cast<uint8_t>(v >> 24);
+    return c;
+  }
+
+  inline bool same_cell(const Pixel &a, const Pixel &b)
+  {
+    return a._ch1 == b._ch1 && a._ch2 == b._ch2 && a._color1 == b._color1 && a._color2 == b._color2;
+  }
+}  // namespace frame_stream
+
+/*!
+ * \class Frame_recorder
+ *
+ * \brief Appends presented buffers to a delta compressed frame stream.
+ */
+class Frame_recorder
+{
+  std::shared_ptr<std::FILE> _file;              //>> Output stream
+  std::unique_ptr<Pixel[]> _previous;            //>> Last recorded frame, what the next one is diffed against
+  size_t _width = 0;                             //>> Width of the recorded buffers
+  size_t _height = 0;                            //>> Height of the recorded buffers
+  std::vector<uint8_t> _scratch;                 //>> Encoded frame, written with a single fwrite
+  std::chrono::steady_clock::time_point _start;  //>> Timestamps are relative to this
+  size_t _frames = 0;                            //>> Frames recorded
+  size_t _bytes = 0;                             //>> Bytes written, header included
+
+public:
+  // Open `path` for writing, the stream header is written on the first frame
+  // @param path The file to record to, truncated if it exists
+  Frame_recorder(const std::string &path)
+  {
+    _file = std::shared_ptr<std::FILE>(std::fopen(path.c_str(), "wb"),
+                                       [](std::FILE *f)
+                                       {
+                                         if (f)
+                                           std::fclose(f);
+                                       });
+    if (!_file)
+    {
+      std::cerr << "Error: Unable to open recording file: " + path << std::endl;
+      return;
+    }
+    std::setvbuf(_file.get(), nullptr, _IOFBF, 1 << 20);
+    _start = std::chrono::steady_clock::now();
+  }
+
+  bool is_open() const { return _file != nullptr; }
+  size_t frame_count() const { return _frames; }
+  size_t bytes_written() const { return _bytes; }
+
+  // Append the cells of `buffer` that changed since the last recorded frame
+  // Only the dirty spans of the buffer are compared, its dirty spans must cover every cell
+  // written since the last recorded frame
+  // @param buffer The buffer being presented
+  // @param bg_color The background color it is presented with
+  void record(const Buffer &buffer, const Color &bg_color)
+  {
+    using namespace frame_stream;
+    if (!_file)
+      return;
+
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+    _scratch.clear();
+
+    // Cells outside the dirty spans of the buffer are the ones of the previous frame, except for
+    // the first frame which is compared to a blank buffer
+    const bool first_frame = !_previous;
+    if (!_previous)
+    {
+      // First frame, write the header and diff against a blank buffer
+      _width = buffer.width;
+      _height = buffer.height;
+      _previous = std::make_unique<Pixel[]>(_width * _height);
+      for (size_t i = 0; i < _width * _height; i++) _previous[i] = Pixel(' ', Color());
+      _scratch.insert(_scratch.end(), file_magic, file_magic + sizeof(file_magic));
+      put_u32(_scratch, static_cast<uint32_t>(_width));
+      put_u32(_scratch, static_cast<uint32_t>(_height));
+    }
+    if (buffer.width != _width || buffer.height != _height)
+    {
+      std::cerr << "Error: Buffer size changed while recording, frame dropped." << std::endl;
+      return;
+    }
+
+    put_u32(_scratch, frame_magic);
+    put_u64(_scratch, timestamp);
+    put_u32(_scratch, pack_color(bg_color));
+    size_t run_count_at = _scratch.size();
+    put_u32(_scratch, 0);
+
+    uint32_t runs = 0;
+    const size_t cells = _width * _height;
+    const Pixel *current = buffer.data.get();
+    size_t i = 0;
+    while (i < cells)
+    {
+      if (!first_frame)
+      {
+        const Dirty_span &span = buffer.dirty[i / _width];
+        size_t x = i % _width;
+        if (x < span.begin)
+        {
+          i += span.begin - x;
+          continue;
+        }
+        if (x >= span.end)
+        {
+          i += _width - x;
+          continue;
+        }
+      }
+      if (same_cell(current[i], _previous[i]))
+      {
+        i++;
+        continue;
+      }
+
+      // Extend the run over changed cells and short unchanged gaps
+      size_t first = i;
+      size_t last = i;
+      for (size_t j = i + 1; j < cells && j <= last + max_gap + 1; j++)
+        if (!same_cell(current[j], _previous[j]))
+          last = j;
+
+      put_u32(_scratch, static_cast<uint32_t>(first));
+      put_u32(_scratch, static_cast<uint32_t>(last - first + 1));
+      for (size_t j = first; j <= last; j++)
+      {
+        const Pixel &p = current[j];
+        _scratch.push_back(static_cast<uint8_t>(p._ch1));
+        _scratch.push_back(static_cast<uint8_t>(p._ch2));
+        for (const Color *c : {&p._color1, &p._color2})
+        {
+          _scratch.push_back(c->r());
+          _scratch.push_back(c->g());
+          _scratch.push_back(c->b());
+          _scratch.push_back(c->a());
+        }
+        _previous[j] = p;
+      }
+      runs++;
+      i = last + 1;
+    }
+
+    for (int b = 0; b < 4; b++) _scratch[run_count_at + b] = static_cast<uint8_t>(runs >> (8 * b));
+    std::fwrite(_scratch.data(), 1, _scratch.size(), _file.get());
+    _bytes += _scratch.size();
+    _frames++;
+  }
+
+  // Push buffered frames to the file
+  void flush()
+  {
+    if (_file)
+      std::fflush(_file.get());
+  }
+};
+
+/*!
+ * \class Frame_player
+ *
+ * \brief Reads a stream written by Frame_recorder back one frame at a time.
+ */
+class Frame_player
+{
+  std::shared_ptr<std::FILE> _file;  //>> Input stream
+  size_t _width = 0;                 //>> Width of the recorded buffers
+  size_t _height = 0;                //>> Height of the recorded buffers
+  std::vector<uint8_t> _scratch;     //>> Run payload being decoded
+
+public:
+  // Open a recording and read its header
+  // @param path The recorded file
+  Frame_player(const std::string &path)
+  {
+    _file = std::shared_ptr<std::FILE>(std::fopen(path.c_str(), "rb"),
+                                       [](std::FILE *f)
+                                       {
+                                         if (f)
+                                           std::fclose(f);
+                                       });
+    if (!_file)
+    {
+      std::cerr << "Error: Unable to open recording file: " + path << std::endl;
+      return;
+    }
+    uint8_t header[16];
+    if (std::fread(header, 1, sizeof(header), _file.get()) != sizeof(header) ||
+        std::memcmp(header, frame_stream::file_magic, sizeof(frame_stream::file_magic)) != 0)
+    {
+      std::cerr << "Error: Not a frame recording: " + path << std::endl;
+      _file.reset();
+      return;
+    }
+    _width = frame_stream::get_u32(header + 8);
+    _height = frame_stream::get_u32(header + 12);
+  }
+
+  bool is_open() const { return _file != nullptr; }
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+
+  // Apply the next frame on top of `buffer`, which must hold the previous frame (blank before the first one)
+  // @param buffer A width() x height() buffer
+  // @param bg_color Set to the background color of the frame
+  // @param timestamp_us Set to the time of the frame, in microseconds since the recording started
+  // @return False at the end of the stream or on a corrupt frame
+  bool next_frame(Buffer &buffer, Color &bg_color, uint64_t &timestamp_us)
+  {
+    using namespace frame_stream;
+    if (!_file || buffer.width != _width || buffer.height != _height)
+      return false;
+
+    uint8_t header[20];
+    if (std::fread(header, 1, sizeof(header), _file.get()) != sizeof(header))
+      return false;
+    if (get_u32(header) != frame_magic)
+    {
+      std::cerr << "Error: Corrupt frame in recording." << std::endl;
+      return false;
+    }
+    timestamp_us = get_u64(header + 4);
+    bg_color = unpack_color(get_u32(header + 12));
+    uint32_t runs = get_u32(header + 16);
+
+    const size_t cells = _width * _height;
+    for (uint32_t r = 0; r < runs; r++)
+    {
+      uint8_t run[8];
+      if (std::fread(run, 1, sizeof(run), _file.get()) != sizeof(run))
+        return false;
+      size_t first = get_u32(run);
+      size_t count = get_u32(run + 4);
+      if (first + count > cells)
+      {
+        std::cerr << "Error: Corrupt run in recording." << std::endl;
+        return false;
+      }
+      _scratch.resize(count * cell_bytes);
+      if (std::fread(_scratch.data(), 1, _scratch.size(), _file.get()) != _scratch.size())
+        return false;
+      for (size_t j = 0; j < count; j++)
+      {
+        const uint8_t *c = &_scratch[j * cell_bytes];
+        buffer.data[first + j] = Pixel(static_cast<char>(c[0]),
+                                       static_cast<char>(c[1]),
+                                       unpack_color(get_u32(c + 2)),
+                                       unpack_color(get_u32(c + 6)));
+        buffer.mark_dirty((first + j) % buffer.width, (first + j) / buffer.width);
+      }
+    }
+    return true;
+  }
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "../dependencies/sprites.hpp"
+#include "basic_units.hpp"
+
+// Flags of a sprite draw
+enum Sprite_flags : uint32_t
+{
+  SPRITE_NONE = 0,
+  SPRITE_FLIP_X = 1,  //>> Mirror horizontally
+  SPRITE_FLIP_Y = 2,  //>> Mirror vertically
+};
+
+// One sprite to draw with Renderer::draw_sprites
+struct Sprite_draw
+{
+  uint32_t id;                   //>> Id returned by Sprite_atlas::add
+  utl::Vec<int, 2> position;     //>> Top left cell
+  uint32_t flags = SPRITE_NONE;  //>> Sprite_flags
+};
+
+/*!
+ * \class Sprite_atlas
+ *
+ * \brief Stores sprites back to back in one array of cells, already paired into the buffer's
+ * two character Pixels, so a sprite row is drawn with a single copy.
+ *
+ * Sprites added with a transparency key also get their opaque spans computed once: every row
+ * is split into runs of cells drawn with a copy, and cells with a single opaque character,
+ * drawn one character at a time so the other half keeps what is under it.
+ */
+class Sprite_atlas
+{
+public:
+  struct Entry
+  {
+    size_t offset;             //>> First cell of the sprite in the atlas
+    size_t width;              //>> Width in cells, (sprite width + 1) / 2
+    size_t height;             //>> Height in cells
+    bool padded = false;       //>> Odd sprite width, the last cell of every row has a blank _ch2
+    bool transparent = false;  //>> Drawn through its runs instead of whole rows
+    size_t first_run = 0;      //>> First run of the sprite in the atlas
+    size_t run_count = 0;      //>> Number of runs, sorted by row
+  };
+
+  // Span of opaque cells of a row
+  struct Run
+  {
+    uint32_t y;       //>> Row in the sprite
+    uint32_t x;       //>> First cell
+    uint32_t length;  //>> Number of cells
+    uint8_t half;     //>> 0 when both characters are opaque, 1 or 2 for a single cell with only _ch1 or _ch2 opaque
+  };
+
+private:
+  std::vector<Pixel> _cells;    //>> All the sprites, row-major one after the other
+  std::vector<Entry> _entries;  //>> Where each sprite lives in _cells
+  std::vector<Run> _runs;       //>> Opaque spans of the transparent sprites
+
+  static_assert(std::is_trivially_copyable<Pixel>::value, "Atlas rows are copied with memcpy");
+
+public:
+  // Add a sprite to the atlas
+  // An odd width leaves a blank second character in the last cell of every row
+  // @return The id of the sprite
+  uint32_t add(const Sprite &sprite)
+  {
+    size_t width = sprite.width(), height = sprite.height();
+    Entry entry{_cells.size(), (width + 1) / 2, height, width % 2 == 1};
+    _cells.resize(_cells.size() + entry.width * entry.height);
+
+    const char *chars = sprite.character_data();
+    const Color *colors = sprite.color_data();
+    Pixel *out = _cells.data() + entry.offset;
+    for (size_t y = 0; y < height; y++)
+      for (size_t x = 0; x < entry.width; x++)
+      {
+        size_t i = y * width + 2 * x;
+        if (2 * x + 1 < width)
+          out[y * entry.width + x] = Pixel(chars[i], chars[i + 1], colors[i], colors[i + 1]);
+        else
+          out[y * entry.width + x] = Pixel(chars[i], ' ', colors[i], Color());
+      }
+
+    _entries.push_back(entry);
+    return static_cast<uint32_t>(_entries.size() - 1);
+  }
+
+  // Add a sprite whose `key` characters are transparent
+  // @return The id of the sprite
+  uint32_t add(const Sprite &sprite, char key)
+  {
+    uint32_t id = add(sprite);
+    Entry &entry = _entries[id];
+    entry.transparent = true;
+    entry.first_run = _runs.size();
+
+    const char *chars = sprite.character_data();
+    const size_t width = sprite.width();
+    auto opaque = [&](size_t y, size_t x) { return x < width && chars[y * width + x] != key; };
+    for (size_t y = 0; y < entry.height; y++)
+    {
+      size_t x = 0;
+      while (x < entry.width)
+      {
+        bool first = opaque(y, 2 * x), second = opaque(y, 2 * x + 1);
+        if (first && second)
+        {
+          size_t start = x;
+          while (x < entry.width && opaque(y, 2 * x) && opaque(y, 2 * x + 1)) x++;
+          _runs.push_back({(uint32_t)y, (uint32_t)start, (uint32_t)(x - start), 0});
+          continue;
+        }
+        if (first || second)
+          _runs.push_back({(uint32_t)y, (uint32_t)x, 1, (uint8_t)(first ? 1 : 2)});
+        x++;
+      }
+    }
+    entry.run_count = _runs.size() - entry.first_run;
+    return id;
+  }
+
+  size_t size() const { return _entries.size(); }
+  bool contains(uint32_t id) const { return id < _entries.size(); }
+  const Entry &entry(uint32_t id) const { return _entries[id]; }
+
+  // First cell of row `y` of sprite `id`
+  const Pixel *row(uint32_t id, size_t y) const { return _cells.data() + _entries[id].offset + y * _entries[id].width; }
+
+  // Opaque runs of sprite `id`, entry(id).run_count of them
+  const Run *runs(uint32_t id) const { return _runs.data() + _entries[id].first_run; }
+
+  void clear()
+  {
+    _cells.clear();
+    _entries.clear();
+    _runs.clear();
+  }
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "basic_units.hpp"
+
+// Sub cell rendering, several "dots" per terminal character
+//
+//   HALF_BLOCK : 1x2 dots per character, U+2580 upper half block with the top dot as the
+//                foreground and the bottom dot as the background, so both dots keep their color
+//   BRAILLE    : 2x4 dots per character, U+2800 + dot bits, one color per character (the
+//                average of its lit dots)
+//
+// A Renderer cell is two characters wide, so it holds 2x2 half block dots or 4x4 braille dots.
+// Characters are written as UTF-8, the terminal has to use a UTF-8 locale and a font with the
+// block and braille glyphs.
+enum class Subcell_mode
+{
+  NONE,
+  HALF_BLOCK,
+  BRAILLE
+};
+
+/*!
+ * \class Subcell_canvas
+ *
+ * \brief A dot framebuffer at sub cell resolution, packed into UTF-8 characters when printed.
+ */
+class Subcell_canvas
+{
+  Subcell_mode _mode = Subcell_mode::NONE;  //>> How dots are packed into characters
+  size_t _columns = 0;                      //>> Characters per row of the output
+  size_t _rows = 0;                         //>> Rows of the output
+  size_t _width = 0;                        //>> Dots per row
+  size_t _height = 0;                       //>> Rows of dots
+  std::vector<Color> _colors;               //>> Color of every dot, row-major
+  std::vector<uint8_t> _lit;                //>> 1 where a dot was drawn since the last clear
+
+  // Writes color escape codes only when the color changes
+  struct Escape_writer
+  {
+    std::string &out;
+    int fg = -1;
+    int bg = -1;
+
+    void code(const char *prefix, int value)
+    {
+      char digits[4];
+      auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+      out += prefix;
+      out.append(digits, end);
+      out += 'm';
+    }
+    void set_fg(int value)
+    {
+      if (value != fg)
+        code("\u001b[38;5;", fg = value);
+    }
+    void set_bg(int value)
+    {
+      if (value != bg)
+        code("\u001b[48;5;", bg = value);
+    }
+  };
+
+public:
+  // Dots per character horizontally and vertically for `mode`
+  static size_t dots_x(Subcell_mode mode) { return mode == Subcell_mode::BRAILLE ? 2 : 1; }
+  static size_t dots_y(Subcell_mode mode)
+  {
+    return mode == Subcell_mode::BRAILLE ? 4 : mode == Subcell_mode::HALF_BLOCK ? 2 : 1;
+  }
+
+  Subcell_canvas() = default;
+
+  // @param mode How dots are packed into characters
+  // @param cells_x, cells_y Size of the renderer buffer, in cells of two characters
+  Subcell_canvas(Subcell_mode mode, size_t cells_x, size_t cells_y) { resize(mode, cells_x, cells_y); }
+
+  void resize(Subcell_mode mode, size_t cells_x, size_t cells_y)
+  {
+    _mode = mode;
+    _columns = mode == Subcell_mode::NONE ? 0 : cells_x * 2;
+    _rows = mode == Subcell_mode::NONE ? 0 : cells_y;
+    _width = _columns * dots_x(mode);
+    _height = _rows * dots_y(mode);
+    _colors.assign(_width * _height, Color());
+    _lit.assign(_width * _height, 0);
+  }
+
+  Subcell_mode mode() const { return _mode; }
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+
+  // Direct access to the dot planes, width() * height() entries in row-major order
+  Color *color_data() { return _colors.data(); }
+  uint8_t *lit_data() { return _lit.data(); }
+
+  // Draw a dot
+  // @return True if the dot is inside the canvas
+  bool set(int x, int y, Color color)
+  {
+    if (x < 0 || y < 0 || static_cast<size_t>(x) >= _width || static_cast<size_t>(y) >= _height)
+      return false;
+    size_t i = y * _width + x;
+    _colors[i] = color;
+    _lit[i] = 1;
+    return true;
+  }
+
+  void unset(int x, int y)
+  {
+    if (x >= 0 && y >= 0 && static_cast<size_t>(x) < _width && static_cast<size_t>(y) < _height)
+      _lit[y * _width + x] = 0;
+  }
+
+  bool is_set(int x, int y) const
+  {
+    return x >= 0 && y >= 0 && static_cast<size_t>(x) < _width && static_cast<size_t>(y) < _height && _lit[y * _width + x];
+  }
+
+  void clear() { std::fill(_lit.begin(), _lit.end(), 0); }
+
+  // Append the frame to `out`, rows separated by newlines
+  // Non blank characters of `overlay` (the renderer buffer) are drawn over the dots, so text
+  // and UI elements stay readable.
+  // @param overlay A buffer of _columns / 2 x _rows cells
+  // @param bg_color Color of the unlit dots
+  void encode(const Buffer &overlay, const Color &bg_color, std::string &out) const
+  {
+    out.reserve(out.size() + _columns * _rows * 8);
+    Escape_writer writer{out};
+    const int bg = bg_color.to_ansii();
+    writer.set_bg(bg);
+    for (size_t row = 0; row < _rows; row++)
+    {
+      for (size_t column = 0; column < _columns; column++)
+      {
+        if (column / 2 < overlay.width && row < overlay.height)
+        {
+          const Pixel &p = overlay.data[row * overlay.width + column / 2];
+          char ch = column & 1 ? p._ch2 : p._ch1;
+          if (ch != ' ')
+          {
+            writer.set_bg(bg);
+            writer.set_fg((column & 1 ? p._color2 : p._color1).to_ansii());
+            out += ch;
+            continue;
+          }
+        }
+        if (_mode == Subcell_mode::HALF_BLOCK)
+          encode_half_block(column, row, bg, writer);
+        else
+          encode_braille(column, row, bg, writer);
+      }
+      writer.set_bg(bg);
+      out += '\n';
+    }
+  }
+
+private:
+  void encode_half_block(size_t column, size_t row, int bg, Escape_writer &writer) const
+  {
+    size_t top = 2 * row * _width + column;
+    size_t bottom = top + _width;
+    bool top_lit = _lit[top], bottom_lit = _lit[bottom];
+    if (!top_lit && !bottom_lit)
+    {
+      writer.set_bg(bg);
+      writer.out += ' ';
+      return;
+    }
+    int top_code = top_lit ? _colors[top].to_ansii() : bg;
+    int bottom_code = bottom_lit ? _colors[bottom].to_ansii() : bg;
+    if (top_code == bottom_code)
+    {
+      // Full block, the background doesn't matter so keep the current one
+      writer.set_fg(top_code);
+      writer.out += "█";
+    }
+    else if (top_lit)
+    {
+      writer.set_fg(top_code);
+      writer.set_bg(bottom_code);
+      writer.out += "▀";
+    }
+    else
+    {
+      writer.set_fg(bottom_code);
+      writer.set_bg(top_code);
+      writer.out += "▄";
+    }
+  }
+
+  void encode_braille(size_t column, size_t row, int bg, Escape_writer &writer) const
+  {
+    // Dot numbering of the braille cell, bit i is dot i + 1
+    //   0 3
+    //   1 4
+    //   2 5
+    //   6 7
+    static constexpr uint8_t bit[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    size_t first = 4 * row * _width + 2 * column;
+    unsigned bits = 0, r = 0, g = 0, b = 0, lit = 0;
+    for (size_t y = 0; y < 4; y++)
+      for (size_t x = 0; x < 2; x++)
+      {
+        size_t i = first + y * _width + x;
+        if (!_lit[i])
+          continue;
+        bits |= bit[y][x];
+        r += _colors[i].r();
+        g += _colors[i].g();
+        b += _colors[i].b();
+        lit++;
+      }
+
+    writer.set_bg(bg);
+    if (!bits)
+    {
+      writer.out += ' ';
+      return;
+    }
+    writer.set_fg(Color(r / lit, g / lit, b / lit).to_ansii());
+    // U+2800 + bits in UTF-8
+    writer.out += static_cast<char>(0xE2);
+    writer.out += static_cast<char>(0xA0 | (bits >> 6));
+    writer.out += static_cast<char>(0x80 | (bits & 0x3F));
+  }
+};
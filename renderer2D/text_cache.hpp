@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "basic_units.hpp"
+
+/*!
+ * \class Text_cache
+ *
+ * \brief Least recently used cache of text runs already rasterized with a font, keyed by
+ * (text, font, color), so static labels drawn every frame skip the glyph lookups.
+ */
+class Text_cache
+{
+public:
+  // A rasterized run, cells relative to the start position of the text
+  struct Run
+  {
+    size_t width = 0;            //>> Width of the run in cells
+    size_t height = 0;           //>> Height of the run in cells
+    int reach = 0;               //>> The run wraps when start.x + reach reaches the buffer width
+    std::vector<Pixel> cells;    //>> width * height cells
+    std::vector<uint8_t> mask;   //>> 1 for the cells the text writes
+  };
+
+private:
+  using Entry = std::pair<std::string, Run>;
+
+  size_t _capacity;                                                        //>> Max runs kept
+  std::list<Entry> _entries;                                               //>> Most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> _lookup;   //>> Key to entry
+  size_t _hits = 0;
+  size_t _misses = 0;
+
+public:
+  // @param capacity Max runs kept, 0 disables the cache
+  Text_cache(size_t capacity = 64) : _capacity(capacity) {}
+
+  static std::string make_key(const std::string &text, uint64_t font_id, const Color &color)
+  {
+    std::string key = text;
+    key.push_back('\0');
+    for (int i = 0; i < 8; i++) key.push_back(static_cast<char>(font_id >> (8 * i)));
+    key.push_back(static_cast<char>(color.r()));
+    key.push_back(static_cast<char>(color.g()));
+    key.push_back(static_cast<char>(color.b()));
+    key.push_back(static_cast<char>(color.a()));
+    return key;
+  }
+
+  // Find a run and mark it as the most recently used
+  // @return The run, nullptr if it isn't cached
+  const Run *find(const std::string &key)
+  {
+    auto it = _lookup.find(key);
+    if (it == _lookup.end())
+    {
+      _misses++;
+      return nullptr;
+    }
+    _hits++;
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return &it->second->second;
+  }
+
+  // Add a run, evicting the least recently used one when full
+  // @return The cached run, or nullptr when the capacity is 0
+  const Run *insert(const std::string &key, Run run)
+  {
+    if (_capacity == 0)
+      return nullptr;
+    auto it = _lookup.find(key);
+    if (it != _lookup.end())
+    {
+      it->second->second = std::move(run);
+      _entries.splice(_entries.begin(), _entries, it->second);
+      return &it->second->second;
+    }
+    if (_entries.size() == _capacity)
+    {
+      _lookup.erase(_entries.back().first);
+      _entries.pop_back();
+    }
+    _entries.emplace_front(key, std::move(run));
+    _lookup[key] = _entries.begin();
+    return &_entries.front().second;
+  }
+
+  void set_capacity(size_t capacity)
+  {
+    _capacity = capacity;
+    while (_entries.size() > _capacity)
+    {
+      _lookup.erase(_entries.back().first);
+      _entries.pop_back();
+    }
+  }
+
+  size_t capacity() const { return _capacity; }
+  size_t size() const { return _entries.size(); }
+  size_t hits() const { return _hits; }
+  size_t misses() const { return _misses; }
+
+  void clear()
+  {
+    _entries.clear();
+    _lookup.clear();
+  }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <list>
+
+#include "../dependencies/sprites.hpp"
+#include "basic_units.hpp"
+
+// What a textured draw samples outside of the sprite
+enum class Texture_wrap
+{
+  CLIP,   //>> Nothing, the cells keep what is under them
+  CLAMP,  //>> The nearest edge texel
+  REPEAT  //>> The sprite tiled infinitely
+};
+
+/*!
+ * \struct Texture_mapping
+ *
+ * \brief Affine map from the buffer to the texels of a sprite, evaluated at the center of every
+ * character (a cell holds two), so it is stepped by constant deltas along a row:
+ *
+ *   u = u0 + column * du_dx + row * du_dy
+ *   v = v0 + column * dv_dx + row * dv_dy
+ */
+struct Texture_mapping
+{
+  // A character is about twice as tall as it is wide, rotations are done in that space so
+  // shapes don't shear
+  static constexpr float char_aspect = 2.0f;
+
+  float u0 = 0, v0 = 0;
+  float du_dx = 1, dv_dx = 0;
+  float du_dy = 0, dv_dy = 1;
+
+  // Put texel `texel` on cell `screen_point`, the sprite being scaled by `scale` and rotated by
+  // `angle` (radians, clockwise on screen) around that point
+  // e.g. affine({W / 2.0f, H / 2.0f}, camera.get_position(), camera.get_zoom(), camera.get_rotation())
+  // for a background following a Camera2D
+  static Texture_mapping affine(utl::Vec<float, 2> screen_point, utl::Vec<float, 2> texel, float scale, float angle)
+  {
+    const float c = std::cos(angle) / scale, s = std::sin(angle) / scale;
+    Texture_mapping m;
+    m.du_dx = c;
+    m.du_dy = s * char_aspect;
+    m.dv_dx = -s / char_aspect;
+    m.dv_dy = c;
+    // Offsets of the center of character (0, 0) from the screen point
+    const float dx = 0.5f - 2 * screen_point.x(), dy = 0.5f - screen_point.y();
+    m.u0 = texel.x() + m.du_dx * dx + m.du_dy * dy;
+    m.v0 = texel.y() + m.dv_dx * dx + m.dv_dy * dy;
+    return m;
+  }
+};
+
+/*!
+ * \class Scaled_sprite_cache
+ *
+ * \brief Copies of sprites pre-scaled to a zoom level, for zooms that stay the same over many
+ * frames (a Camera2D that is not zooming), so the per frame draw is a plain draw_sprite.
+ *
+ *   renderer.draw_sprite(position, cache.get(tree, camera.get_zoom()));
+ *
+ * Entries are keyed by the address of the sprite, call invalidate() after changing one.
+ * A copy returned by get() may be evicted by the next get(), so use it right away instead of
+ * keeping the reference.
+ */
+class Scaled_sprite_cache
+{
+  struct Entry
+  {
+    const Sprite *source;  //>> Sprite the copy was made from
+    size_t source_width;   //>> Size of the source when it was scaled
+    size_t source_height;
+    int zoom_step;         //>> Zoom in 1 / zoom_steps units
+    Sprite sprite;         //>> The scaled copy
+  };
+
+  size_t _capacity;             //>> Max copies kept
+  std::list<Entry> _entries;    //>> Most recently used first, a list so a hit doesn't move the copies
+
+public:
+  // Zooms are rounded to 1 / zoom_steps, close zooms share their copy
+  static constexpr float zoom_steps = 16.0f;
+
+  Scaled_sprite_cache(size_t capacity = 32) : _capacity(capacity) {}
+
+  // A copy of `sprite` scaled by `zoom`, made on the first call for that zoom level
+  // The reference is valid until the next call to get(), invalidate() or clear(), a full cache
+  // evicts its least recently used copy to make room
+  const Sprite &get(const Sprite &sprite, float zoom)
+  {
+    const int step = std::max(1, static_cast<int>(std::lround(zoom * zoom_steps)));
+    for (auto it = _entries.begin(); it != _entries.end(); ++it)
+      if (it->source == &sprite && it->zoom_step == step && it->source_width == sprite.width() &&
+          it->source_height == sprite.height())
+      {
+        _entries.splice(_entries.begin(), _entries, it);
+        return _entries.front().sprite;
+      }
+
+    const float scale = step / zoom_steps;
+    size_t width = std::max<size_t>(1, std::lround(sprite.width() * scale));
+    size_t height = std::max<size_t>(1, std::lround(sprite.height() * scale));
+    if (_capacity && _entries.size() >= _capacity)
+      _entries.pop_back();
+    _entries.push_front({&sprite, sprite.width(), sprite.height(), step, sprite.scaled(width, height)});
+    return _entries.front().sprite;
+  }
+
+  // Drop the copies of `sprite`
+  void invalidate(const Sprite &sprite)
+  {
+    _entries.remove_if([&](const Entry &entry) { return entry.source == &sprite; });
+  }
+
+  size_t size() const { return _entries.size(); }
+  size_t capacity() const { return _capacity; }
+  void clear() { _entries.clear(); }
+};
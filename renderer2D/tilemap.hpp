@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../dependencies/sprites.hpp"
+#include "basic_units.hpp"
+#include "sprite_atlas.hpp"
+
+/*!
+ * \class Tilemap
+ *
+ * \brief A layer of equally sized tiles, split into square chunks of chunk_tiles x chunk_tiles
+ * tiles that are rasterized into cells once and then blitted, so scrolling only copies the
+ * chunks on screen.
+ *
+ * Editing a tile marks its chunk dirty, it is rasterized again the next time it is drawn.
+ * Chunks are allocated on the first tile set in them and at most `max_rasterized` chunks keep
+ * their cells, the ones drawn least recently give theirs up first.
+ *
+ *   Tilemap map(10000, 10000);
+ *   Tilemap::Tile grass = map.add_tile(Sprite("grass.txt"));
+ *   map.fill(0, 0, 10000, 10000, grass);
+ *   renderer.draw_tilemap(map, camera);
+ */
+class Tilemap
+{
+public:
+  using Tile = uint16_t;
+  static constexpr Tile empty_tile = 0;       //>> Nothing is drawn for it
+  static constexpr size_t chunk_tiles = 32;   //>> Tiles per side of a chunk
+
+private:
+  struct Chunk
+  {
+    std::vector<Tile> tiles;       //>> chunk_tiles * chunk_tiles tiles, row-major
+    std::vector<Pixel> cells;      //>> Rasterized tiles, empty when not rasterized
+    std::vector<uint8_t> halves;   //>> Per cell, bit 0 (1) when _ch1 (_ch2) was written by a tile
+    bool dirty = true;             //>> Tiles changed since the cells were rasterized
+    bool opaque = false;           //>> Every cell is fully written, rows are copied whole
+    uint64_t last_drawn = 0;       //>> Frame the chunk was last drawn on
+  };
+
+  size_t _width;                                //>> Width of the map in tiles
+  size_t _height;                               //>> Height of the map in tiles
+  size_t _chunks_x;                             //>> Chunks per row
+  size_t _chunks_y;                             //>> Rows of chunks
+  std::vector<std::unique_ptr<Chunk>> _chunks;  //>> nullptr until a tile is set in the chunk
+  Sprite_atlas _atlas;                          //>> Sprites of the tiles
+  std::vector<uint32_t> _tile_ids;              //>> Atlas id of every tile, tile t is _tile_ids[t - 1]
+  size_t _tile_width = 0;                       //>> Size of a tile in cells
+  size_t _tile_height = 0;
+  size_t _max_rasterized;                       //>> Max chunks holding cells
+  std::vector<size_t> _rasterized;              //>> Chunks holding cells
+  uint64_t _frame = 0;                          //>> Number of draw calls
+  size_t _rasterizations = 0;                   //>> Chunks rasterized so far
+
+public:
+  // @param width, height Size of the map in tiles
+  // @param max_rasterized Max chunks keeping their cells between frames
+  Tilemap(size_t width, size_t height, size_t max_rasterized = 256)
+      : _width(width),
+        _height(height),
+        _chunks_x((width + chunk_tiles - 1) / chunk_tiles),
+        _chunks_y((height + chunk_tiles - 1) / chunk_tiles),
+        _max_rasterized(std::max<size_t>(max_rasterized, 1))
+  {
+    _chunks.resize(_chunks_x * _chunks_y);
+  }
+
+  // Add a tile, every tile has the size of the first one
+  // @return The tile, empty_tile if the sprite doesn't have the size of the others
+  Tile add_tile(const Sprite &sprite) { return add_tile(sprite, [&] { return _atlas.add(sprite); }); }
+
+  // Add a tile whose `key` characters are transparent, the tiles of the layers under it show through
+  Tile add_tile(const Sprite &sprite, char key) { return add_tile(sprite, [&] { return _atlas.add(sprite, key); }); }
+
+  void set(size_t x, size_t y, Tile tile)
+  {
+    if (x >= _width || y >= _height || tile > _tile_ids.size())
+      return;
+    auto &chunk = _chunks[(y / chunk_tiles) * _chunks_x + x / chunk_tiles];
+    if (!chunk)
+    {
+      if (tile == empty_tile)
+        return;
+      chunk = std::make_unique<Chunk>();
+      chunk->tiles.assign(chunk_tiles * chunk_tiles, empty_tile);
+    }
+    Tile &slot = chunk->tiles[(y % chunk_tiles) * chunk_tiles + x % chunk_tiles];
+    if (slot != tile)
+    {
+      slot = tile;
+      chunk->dirty = true;
+    }
+  }
+
+  Tile get(size_t x, size_t y) const
+  {
+    if (x >= _width || y >= _height)
+      return empty_tile;
+    const auto &chunk = _chunks[(y / chunk_tiles) * _chunks_x + x / chunk_tiles];
+    return chunk ? chunk->tiles[(y % chunk_tiles) * chunk_tiles + x % chunk_tiles] : empty_tile;
+  }
+
+  // Set a rectangle of tiles
+  void fill(size_t x, size_t y, size_t width, size_t height, Tile tile)
+  {
+    for (size_t j = y; j < std::min(y + height, _height); j++)
+      for (size_t i = x; i < std::min(x + width, _width); i++) set(i, j, tile);
+  }
+
+  // Draw the chunks overlapping the buffer
+  // @param origin The cell the top left corner of tile (0, 0) lands on
+  void draw(Buffer &buffer, utl::Vec<int, 2> origin)
+  {
+    _frame++;
+    if (!_tile_width || !_tile_height)
+      return;
+    const long chunk_width = static_cast<long>(chunk_tiles * _tile_width);
+    const long chunk_height = static_cast<long>(chunk_tiles * _tile_height);
+    // Chunks overlapping [0, buffer size) once moved by origin
+    long cx0 = std::max(0L, floor_div(-origin.x(), chunk_width));
+    long cy0 = std::max(0L, floor_div(-origin.y(), chunk_height));
+    long cx1 = std::min((long)_chunks_x, floor_div((long)buffer.width - 1 - origin.x(), chunk_width) + 1);
+    long cy1 = std::min((long)_chunks_y, floor_div((long)buffer.height - 1 - origin.y(), chunk_height) + 1);
+    for (long cy = cy0; cy < cy1; cy++)
+      for (long cx = cx0; cx < cx1; cx++)
+      {
+        size_t index = cy * _chunks_x + cx;
+        Chunk *chunk = _chunks[index].get();
+        if (!chunk)
+          continue;
+        if (chunk->dirty || chunk->cells.empty())
+        {
+          if (chunk->cells.empty())
+            _rasterized.push_back(index);
+          rasterize(*chunk);
+        }
+        chunk->last_drawn = _frame;
+        blit(*chunk, buffer, origin.x() + cx * chunk_width, origin.y() + cy * chunk_height);
+      }
+    evict();
+  }
+
+  // Rasterize every chunk again on its next draw, e.g. after changing the sprite of a tile
+  void invalidate()
+  {
+    for (auto &chunk : _chunks)
+      if (chunk)
+        chunk->dirty = true;
+  }
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  size_t tile_width() const { return _tile_width; }
+  size_t tile_height() const { return _tile_height; }
+  size_t tile_count() const { return _tile_ids.size(); }
+  size_t rasterized_chunks() const { return _rasterized.size(); }
+  size_t rasterizations() const { return _rasterizations; }
+
+private:
+  template <typename Add>
+  Tile add_tile(const Sprite &sprite, Add add)
+  {
+    size_t width = (sprite.width() + 1) / 2, height = sprite.height();
+    if (!width || !height)
+    {
+      std::cerr << "Error: Empty tile sprite" << std::endl;
+      return empty_tile;
+    }
+    if (_tile_ids.empty())
+    {
+      _tile_width = width;
+      _tile_height = height;
+    }
+    else if (width != _tile_width || height != _tile_height)
+    {
+      std::cerr << "Error: Tile of " << width << "x" << height << " cells in a tilemap of " << _tile_width << "x" << _tile_height
+                << " tiles" << std::endl;
+      return empty_tile;
+    }
+    if (_tile_ids.size() >= 0xFFFF)
+    {
+      std::cerr << "Error: Too many tiles in the tilemap" << std::endl;
+      return empty_tile;
+    }
+    _tile_ids.push_back(add());
+    return static_cast<Tile>(_tile_ids.size());
+  }
+
+  static long floor_div(long a, long b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+  void rasterize(Chunk &chunk)
+  {
+    _rasterizations++;
+    const size_t row_cells = chunk_tiles * _tile_width;
+    chunk.cells.assign(row_cells * chunk_tiles * _tile_height, Pixel());
+    chunk.halves.assign(chunk.cells.size(), 0);
+    for (size_t ty = 0; ty < chunk_tiles; ty++)
+      for (size_t tx = 0; tx < chunk_tiles; tx++)
+      {
+        Tile tile = chunk.tiles[ty * chunk_tiles + tx];
+        if (tile == empty_tile)
+          continue;
+        uint32_t id = _tile_ids[tile - 1];
+        const Sprite_atlas::Entry &entry = _atlas.entry(id);
+        size_t first = ty * _tile_height * row_cells + tx * _tile_width;
+        if (!entry.transparent)
+        {
+          for (size_t y = 0; y < _tile_height; y++)
+          {
+            std::memcpy(&chunk.cells[first + y * row_cells], _atlas.row(id, y), _tile_width * sizeof(Pixel));
+            std::memset(&chunk.halves[first + y * row_cells], 3, _tile_width);
+          }
+          continue;
+        }
+        const Sprite_atlas::Run *runs = _atlas.runs(id);
+        for (size_t r = 0; r < entry.run_count; r++)
+        {
+          const Sprite_atlas::Run &run = runs[r];
+          size_t at = first + run.y * row_cells + run.x;
+          const Pixel *src = _atlas.row(id, run.y) + run.x;
+          if (run.half == 0)
+          {
+            std::memcpy(&chunk.cells[at], src, run.length * sizeof(Pixel));
+            std::memset(&chunk.halves[at], 3, run.length);
+          }
+          else
+          {
+            chunk.cells[at] = *src;
+            chunk.halves[at] = run.half;
+          }
+        }
+      }
+    chunk.opaque = std::all_of(chunk.halves.begin(), chunk.halves.end(), [](uint8_t h) { return h == 3; });
+    chunk.dirty = false;
+  }
+
+  void blit(const Chunk &chunk, Buffer &buffer, long left, long top) const
+  {
+    const long row_cells = static_cast<long>(chunk_tiles * _tile_width);
+    const long rows = static_cast<long>(chunk_tiles * _tile_height);
+    long x0 = std::max(0L, -left), x1 = std::min(row_cells, (long)buffer.width - left);
+    long y0 = std::max(0L, -top), y1 = std::min(rows, (long)buffer.height - top);
+    for (long y = y0; y < y1; y++)
+    {
+      const Pixel *src = &chunk.cells[y * row_cells];
+      const uint8_t *halves = &chunk.halves[y * row_cells];
+      Pixel *out = &buffer.data[(top + y) * buffer.width + left];
+      buffer.mark_row_dirty(top + y, left + x0, left + x1);
+      if (chunk.opaque)
+      {
+        std::memcpy(out + x0, src + x0, (x1 - x0) * sizeof(Pixel));
+        continue;
+      }
+      for (long x = x0; x < x1; x++)
+      {
+        if (halves[x] == 3)
+          out[x] = src[x];
+        else if (halves[x] == 1)
+        {
+          out[x].set_char(src[x]._ch1, out[x]._ch2);
+          out[x]._color1 = src[x]._color1;
+        }
+        else if (halves[x] == 2)
+        {
+          out[x].set_char(out[x]._ch1, src[x]._ch2);
+          out[x]._color2 = src[x]._color2;
+        }
+      }
+    }
+  }
+
+  // Drop the cells of the chunks drawn least recently while over the budget
+  void evict()
+  {
+    if (_rasterized.size() <= _max_rasterized)
+      return;
+    auto by_age = [&](size_t a, size_t b) { return _chunks[a]->last_drawn > _chunks[b]->last_drawn; };
+    std::nth_element(_rasterized.begin(), _rasterized.begin() + _max_rasterized, _rasterized.end(), by_age);
+    for (size_t i = _max_rasterized; i < _rasterized.size(); i++)
+    {
+      Chunk &chunk = *_chunks[_rasterized[i]];
+      chunk.cells = std::vector<Pixel>();
+      chunk.halves = std::vector<uint8_t>();
+    }
+    _rasterized.resize(_max_rasterized);
+  }
+};
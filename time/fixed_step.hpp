@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+
+#include "frame_rate.hpp"
+
+// Fixed-timestep driver for simulations
+// Real frame time is accumulated and drained in constant `step` sized ticks, so the
+// simulation stays stable whatever the render load. alpha() tells how far the
+// accumulator is into the next tick, to interpolate between the last two states.
+//
+//   Fixed_step sim(1.0 / 120.0);
+//   while (true)
+//   {
+//     fps.start_frame();
+//     sim.update(fps, [&](double dt) { physics(dt); });
+//     draw(lerp(previous, current, sim.alpha()));
+//     fps.end_frame();
+//   }
+class Fixed_step
+{
+  private:
+  double step;
+  double accumulator;
+  double max_frame_time;
+  int max_steps;
+  int last_steps;
+  long long total_steps;
+  long long dropped_steps;
+
+  // Written with the bound first so NaN is clamped too
+  static double valid_step(double seconds) { return std::max(min_step, seconds); }
+
+  public:
+  static constexpr double min_step = 1e-6;  // Smaller steps, zero, negative and NaN are clamped to this
+
+  // @param step Simulation tick in seconds, at least min_step
+  // @param max_steps Max ticks run per frame before the rest of the backlog is dropped
+  // @param max_frame_time Frame times above this (seconds) are clamped, e.g. after a breakpoint
+  Fixed_step(double step = 1.0 / 60.0, int max_steps = 5, double max_frame_time = 0.25)
+      : step(valid_step(step)),
+        accumulator(0.0),
+        max_frame_time(max_frame_time),
+        max_steps(std::max(max_steps, 1)),
+        last_steps(0),
+        total_steps(0),
+        dropped_steps(0)
+  {
+  }
+
+  // Add `frame_time` seconds to the accumulator and run `update(step)` for each whole tick in it
+  // @return Number of ticks run this frame
+  template <typename Update_fn>
+  int update(double frame_time, Update_fn &&update_fn)
+  {
+    accumulator += std::clamp(frame_time, 0.0, max_frame_time);
+
+    last_steps = 0;
+    while (accumulator >= step && last_steps < max_steps)
+    {
+      update_fn(step);
+      accumulator -= step;
+      last_steps++;
+    }
+    total_steps += last_steps;
+
+    // Could not catch up, drop the whole ticks left so we don't spiral further behind
+    if (accumulator >= step)
+    {
+      long long behind = static_cast<long long>(accumulator / step);
+      dropped_steps += behind;
+      accumulator -= behind * step;
+    }
+    return last_steps;
+  }
+
+  // Same as above, using the full duration of the last frame measured by `frame_rate`
+  template <typename Update_fn>
+  int update(const Frame_rate &frame_rate, Update_fn &&update_fn)
+  {
+    return update(frame_rate.get_frame_time(), std::forward<Update_fn>(update_fn));
+  }
+
+  // Interpolation factor in [0, 1) between the previous and the current simulation state
+  double alpha() const { return accumulator / step; }
+
+  double get_step() const { return step; }
+  void set_step(double seconds) { step = valid_step(seconds); }
+  int get_max_steps() const { return max_steps; }
+  void set_max_steps(int steps) { max_steps = std::max(steps, 1); }
+
+  int get_last_steps() const { return last_steps; }
+  long long get_total_steps() const { return total_steps; }
+  long long get_dropped_steps() const { return dropped_steps; }
+
+  void reset()
+  {
+    accumulator = 0.0;
+    last_steps = 0;
+    total_steps = 0;
+    dropped_steps = 0;
+  }
+};
@@ -1,44 +1,137 @@
 #pragma once
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <thread>
+#include <vector>
+
+#include "profiler.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// How end_frame() waits for the frame deadline
+// SLEEP  : sleep_until the deadline, overshoots by the scheduler granularity
+// HYBRID : sleep until `spin_margin` before the deadline, then busy-wait the rest
+enum class Pacing_mode
+{
+  SLEEP,
+  HYBRID
+};
+
+// Ring buffer of the most recent frame durations (in seconds)
+class Frame_stats
+{
+  private:
+  std::vector<double> samples;
+  std::vector<double> sorted;  // The samples in the ring in increasing order, kept up to date by push
+  size_t head;
+  size_t count;
+  size_t missed_deadlines;
+
+  public:
+  Frame_stats(size_t capacity = 240) : samples(std::max<size_t>(capacity, 1), 0.0), head(0), count(0), missed_deadlines(0) {}
+
+  void push(double frame_duration, bool missed)
+  {
+    if (count == samples.size())
+      sorted.erase(std::lower_bound(sorted.begin(), sorted.end(), samples[head]));
+    sorted.insert(std::upper_bound(sorted.begin(), sorted.end(), frame_duration), frame_duration);
+    samples[head] = frame_duration;
+    head = (head + 1) % samples.size();
+    if (count < samples.size())
+      count++;
+    if (missed)
+      missed_deadlines++;
+  }
+
+  // Frame duration at percentile p in [0, 1], over the samples currently in the ring
+  double percentile(double p) const
+  {
+    if (count == 0)
+      return 0.0;
+    size_t n = static_cast<size_t>(std::clamp(p, 0.0, 1.0) * (count - 1) + 0.5);
+    return sorted[n];
+  }
+
+  double p50() const { return percentile(0.50); }
+  double p95() const { return percentile(0.95); }
+  double p99() const { return percentile(0.99); }
+
+  double mean() const
+  {
+    if (count == 0)
+      return 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) sum += samples[i];
+    return sum / count;
+  }
+
+  double max() const
+  {
+    if (count == 0)
+      return 0.0;
+    return *std::max_element(samples.begin(), samples.begin() + count);
+  }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return samples.size(); }
+  size_t get_missed_deadlines() const { return missed_deadlines; }
+
+  void resize(size_t capacity)
+  {
+    samples.assign(std::max<size_t>(capacity, 1), 0.0);
+    sorted.clear();
+    head = 0;
+    count = 0;
+  }
+
+  void reset()
+  {
+    sorted.clear();
+    head = 0;
+    count = 0;
+    missed_deadlines = 0;
+  }
+};
 
 class Frame_rate
 {
+  using clock = std::chrono::steady_clock;
+
   private:
   int target_fps;
   int actual_fps;
   int frame_count;
-  std::chrono::time_point<std::chrono::high_resolution_clock> program_start_time;
-  std::chrono::time_point<std::chrono::high_resolution_clock> fps_start_time;
-  std::chrono::time_point<std::chrono::high_resolution_clock> frame_start_time;
+  clock::time_point program_start_time;
+  clock::time_point fps_start_time;
+  clock::time_point frame_start_time;
   std::chrono::duration<double> target_frame_duration;
-  std::chrono::time_point<std::chrono::high_resolution_clock> last_interval_check;
+  clock::time_point last_interval_check;
   double last_frame_duration;
+  double last_full_frame_duration;
+  Pacing_mode pacing_mode;
+  std::chrono::duration<double> spin_margin;
+  Frame_stats stats;
 
   public:
-  Frame_rate()
-      : target_fps(24),
-        actual_fps(0),
-        frame_count(0),
-        program_start_time(std::chrono::high_resolution_clock::now()),
-        fps_start_time(std::chrono::high_resolution_clock::now()),
-        frame_start_time(std::chrono::high_resolution_clock::now()),
-        target_frame_duration(1.0 / target_fps),
-        last_interval_check(std::chrono::high_resolution_clock::now()),
-        last_frame_duration(0.0)
-  {
-  }
+  Frame_rate() : Frame_rate(24) {}
 
-  Frame_rate(int target_fps)
+  Frame_rate(int target_fps, Pacing_mode mode = Pacing_mode::SLEEP)
       : target_fps(target_fps),
         actual_fps(0),
         frame_count(0),
-        program_start_time(std::chrono::high_resolution_clock::now()),
-        fps_start_time(std::chrono::high_resolution_clock::now()),
-        frame_start_time(std::chrono::high_resolution_clock::now()),
+        program_start_time(clock::now()),
+        fps_start_time(clock::now()),
+        frame_start_time(clock::now()),
         target_frame_duration(1.0 / target_fps),
-        last_interval_check(std::chrono::high_resolution_clock::now()),
-        last_frame_duration(0.0)
+        last_interval_check(clock::now()),
+        last_frame_duration(0.0),
+        last_full_frame_duration(0.0),
+        pacing_mode(mode),
+        spin_margin(0.002),
+        stats()
   {
   }
 
@@ -51,19 +144,38 @@ class Frame_rate
   int get_target_fps() const { return target_fps; }
   int get_actual_fps() const { return actual_fps; }
 
-  double get_elapsed_time() const
+  // FPS from the mean of the recorded frame durations, not truncated and updated every frame
+  double get_smoothed_fps() const
   {
-    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - program_start_time).count();
+    double mean = stats.mean();
+    return mean > 0.0 ? 1.0 / mean : 0.0;
   }
 
+  void set_pacing_mode(Pacing_mode mode) { pacing_mode = mode; }
+  Pacing_mode get_pacing_mode() const { return pacing_mode; }
+
+  // In HYBRID mode, stop sleeping this many seconds before the deadline and spin the rest
+  void set_spin_margin(double seconds) { spin_margin = std::chrono::duration<double>(std::max(0.0, seconds)); }
+  double get_spin_margin() const { return spin_margin.count(); }
+
+  double get_elapsed_time() const { return std::chrono::duration<double>(clock::now() - program_start_time).count(); }
+
+  // Time spent between start_frame() and end_frame(), i.e. the work done in the frame
   double get_delta_time() const { return last_frame_duration; }
   double get_current_frame_duration() const { return last_frame_duration; }
 
-  void start_frame() { frame_start_time = std::chrono::high_resolution_clock::now(); }
+  // Full duration of the last frame including the time spent waiting for the deadline
+  double get_frame_time() const { return last_full_frame_duration; }
+
+  const Frame_stats &get_stats() const { return stats; }
+  void set_stats_window(size_t frames) { stats.resize(frames); }
+  size_t get_missed_deadlines() const { return stats.get_missed_deadlines(); }
+
+  void start_frame() { frame_start_time = clock::now(); }
 
   void end_frame()
   {
-    auto now = std::chrono::high_resolution_clock::now();
+    auto now = clock::now();
     last_frame_duration = std::chrono::duration<double>(now - frame_start_time).count();
     frame_count++;
 
@@ -76,20 +188,27 @@ class Frame_rate
       fps_start_time = now;
     }
 
-    auto frame_end = frame_start_time + target_frame_duration;
-    if (now < frame_end)
-      std::this_thread::sleep_until(frame_end);
+    auto frame_end = frame_start_time + std::chrono::duration_cast<clock::duration>(target_frame_duration);
+    bool missed = now > frame_end;
+    if (!missed)
+      wait_until(frame_end);
+
+    last_full_frame_duration = std::chrono::duration<double>(clock::now() - frame_start_time).count();
+    stats.push(last_full_frame_duration, missed);
+    PROFILE_FRAME_END();
   }
 
   void reset()
   {
-    program_start_time = std::chrono::high_resolution_clock::now();
-    fps_start_time = std::chrono::high_resolution_clock::now();
-    frame_start_time = std::chrono::high_resolution_clock::now();
-    last_interval_check = std::chrono::high_resolution_clock::now();
+    program_start_time = clock::now();
+    fps_start_time = clock::now();
+    frame_start_time = clock::now();
+    last_interval_check = clock::now();
     actual_fps = 0;
     frame_count = 0;
     last_frame_duration = 0.0;
+    last_full_frame_duration = 0.0;
+    stats.reset();
   }
 
   void reset_frame_count() { frame_count = 0; }
@@ -108,7 +227,7 @@ class Frame_rate
 
   bool has_passed(float seconds)
   {
-    auto now = std::chrono::high_resolution_clock::now();
+    auto now = clock::now();
     auto elapsed = std::chrono::duration<double>(now - last_interval_check).count();
 
     if (elapsed >= seconds)
@@ -118,4 +237,25 @@ class Frame_rate
     }
     return false;
   }
+
+  private:
+  void wait_until(clock::time_point deadline) const
+  {
+    if (pacing_mode == Pacing_mode::SLEEP)
+    {
+      std::this_thread::sleep_until(deadline);
+      return;
+    }
+
+    auto sleep_end = deadline - std::chrono::duration_cast<clock::duration>(spin_margin);
+    if (clock::now() < sleep_end)
+      std::this_thread::sleep_until(sleep_end);
+
+    while (clock::now() < deadline)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#endif
+    }
+  }
 };
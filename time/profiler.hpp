@@ -0,0 +1,279 @@
+#pragma once
+
+// Per-phase frame profiler
+// Everything here is compiled out unless ENABLE_PROFILER is defined before the first include,
+// the PROFILE_* macros then expand to nothing and no Profiler code is instantiated.
+//
+//   void Renderer::print()
+//   {
+//     PROFILE_SCOPE("encode");
+//     ...
+//   }
+//
+// Zones with the same name are summed into one row. A scope opened inside another scope of the
+// same zone, e.g. draw_textbox calling draw_fill_rectangle, is neither timed nor counted, only the
+// outermost one is, so nested draw calls are not counted twice. Frame boundaries come from
+// PROFILE_FRAME_END(), which Frame_rate::end_frame() already calls.
+// The profiler is meant for the main thread only.
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class Profiler
+{
+  using clock = std::chrono::steady_clock;
+
+public:
+  static constexpr size_t max_zones = 64;
+
+  struct Zone
+  {
+    const char *name;
+    uint64_t frame_ns = 0;     //>> Time accumulated in the current frame
+    uint32_t frame_calls = 0;  //>> Calls in the current frame
+    uint64_t last_ns = 0;      //>> Time spent in the last finished frame
+    uint32_t last_calls = 0;   //>> Calls in the last finished frame
+    double avg_ns = 0.0;       //>> Exponential moving average of last_ns
+  };
+
+  struct Trace_event
+  {
+    uint16_t zone;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+  };
+
+private:
+  Zone _zones[max_zones];
+  size_t _zone_count = 0;
+  clock::time_point _epoch = clock::now();
+  clock::time_point _frame_start = clock::now();
+  uint64_t _last_frame_ns = 0;
+  uint64_t _frame_index = 0;
+
+  // Per frame history, one row of _zone_count + 1 values (frame time first) per frame
+  std::vector<std::vector<uint64_t>> _history;
+  size_t _history_limit = 600;
+
+  std::vector<Trace_event> _trace;
+  size_t _trace_limit = 1 << 20;
+  bool _trace_enabled = false;
+
+  Profiler() = default;
+
+public:
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  static Profiler &get()
+  {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  // Get the id of the zone named `name`, creating it if needed
+  // @param name A string with static storage, the pointer is kept
+  // @return The zone id, or max_zones if the table is full
+  size_t register_zone(const char *name)
+  {
+    for (size_t i = 0; i < _zone_count; i++)
+      if (std::strcmp(_zones[i].name, name) == 0)
+        return i;
+    if (_zone_count == max_zones)
+      return max_zones;
+    _zones[_zone_count].name = name;
+    return _zone_count++;
+  }
+
+  // Scopes of `zone` currently open on the calling thread
+  static uint32_t &depth(size_t zone)
+  {
+    thread_local uint32_t depths[max_zones + 1] = {};  // max_zones is the id handed out when the table is full
+    return depths[zone];
+  }
+
+  uint64_t now_ns() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _epoch).count(); }
+
+  void record(size_t zone, uint64_t start_ns, uint64_t end_ns)
+  {
+    if (zone >= _zone_count)
+      return;
+    _zones[zone].frame_ns += end_ns - start_ns;
+    _zones[zone].frame_calls++;
+    if (_trace_enabled && _trace.size() < _trace_limit)
+      _trace.push_back({static_cast<uint16_t>(zone), start_ns, end_ns - start_ns});
+  }
+
+  // Close the current frame, latch the per-zone totals and start a new frame
+  void end_frame()
+  {
+    auto now = clock::now();
+    _last_frame_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _frame_start).count();
+    _frame_start = now;
+
+    std::vector<uint64_t> row;
+    if (_history_limit)
+    {
+      row.reserve(_zone_count + 1);
+      row.push_back(_last_frame_ns);
+    }
+    for (size_t i = 0; i < _zone_count; i++)
+    {
+      Zone &z = _zones[i];
+      z.last_ns = z.frame_ns;
+      z.last_calls = z.frame_calls;
+      z.avg_ns = _frame_index == 0 ? z.last_ns : z.avg_ns * 0.9 + z.last_ns * 0.1;
+      z.frame_ns = 0;
+      z.frame_calls = 0;
+      if (_history_limit)
+        row.push_back(z.last_ns);
+    }
+    if (_history_limit)
+    {
+      if (_history.size() == _history_limit)
+        _history.erase(_history.begin());
+      _history.push_back(std::move(row));
+    }
+    _frame_index++;
+  }
+
+  size_t zone_count() const { return _zone_count; }
+  const Zone &zone(size_t i) const { return _zones[i]; }
+  uint64_t last_frame_ns() const { return _last_frame_ns; }
+  uint64_t frame_index() const { return _frame_index; }
+
+  // Number of frames kept for dump_csv(), 0 disables the history
+  void set_history_limit(size_t frames)
+  {
+    _history_limit = frames;
+    if (_history.size() > frames)
+      _history.erase(_history.begin(), _history.end() - frames);
+  }
+
+  // Record every scope as a trace event for dump_chrome_trace(), up to `max_events`
+  void set_trace_enabled(bool enabled, size_t max_events = 1 << 20)
+  {
+    _trace_enabled = enabled;
+    _trace_limit = max_events;
+  }
+
+  void reset()
+  {
+    for (size_t i = 0; i < _zone_count; i++) _zones[i] = Zone{_zones[i].name};
+    _history.clear();
+    _trace.clear();
+    _frame_index = 0;
+    _frame_start = clock::now();
+  }
+
+  // Write the per frame history as CSV, one row per frame, times in microseconds
+  bool dump_csv(const std::string &path) const
+  {
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Unable to open profiler output file: " + path << std::endl;
+      return false;
+    }
+    file << "frame";
+    for (size_t i = 0; i < _zone_count; i++) file << "," << _zones[i].name;
+    file << "\n";
+    for (const auto &row : _history)
+    {
+      for (size_t i = 0; i < row.size(); i++) file << (i ? "," : "") << row[i] / 1000.0;
+      // Zones registered after this frame was recorded
+      for (size_t i = row.size(); i < _zone_count + 1; i++) file << ",0";
+      file << "\n";
+    }
+    return true;
+  }
+
+  // Write the recorded trace events in the Chrome trace event format (chrome://tracing, Perfetto)
+  bool dump_chrome_trace(const std::string &path) const
+  {
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+      std::cerr << "Error: Unable to open profiler output file: " + path << std::endl;
+      return false;
+    }
+    file << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < _trace.size(); i++)
+    {
+      const Trace_event &e = _trace[i];
+      char line[256];
+      std::snprintf(line,
+                    sizeof(line),
+                    "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                    _zones[e.zone].name,
+                    e.start_ns / 1000.0,
+                    e.duration_ns / 1000.0,
+                    i + 1 < _trace.size() ? "," : "");
+      file << line;
+    }
+    file << "]}\n";
+    return true;
+  }
+
+  // Draw a table of the zones (average ms, calls in the last frame) with renderer.draw_text
+  template <typename Renderer_t, typename Color_t>
+  void draw_hud(Renderer_t &renderer, int x, int y, Color_t color) const
+  {
+    char line[96];
+    std::snprintf(line, sizeof(line), "frame %7.3f ms", _last_frame_ns / 1e6);
+    renderer.draw_text({x, y++}, line, color);
+    for (size_t i = 0; i < _zone_count; i++)
+    {
+      const Zone &z = _zones[i];
+      std::snprintf(line, sizeof(line), "%-10.10s %7.3f ms %5u", z.name, z.avg_ns / 1e6, z.last_calls);
+      renderer.draw_text({x, y++}, line, color);
+    }
+  }
+};
+
+// RAII timer adding the lifetime of the scope to a profiler zone, unless a scope of the same zone
+// is already open on this thread
+class Profile_scope
+{
+  size_t _zone;
+  uint64_t _start = 0;
+
+public:
+  Profile_scope(size_t zone) : _zone(zone)
+  {
+    if (Profiler::depth(_zone)++ == 0)
+      _start = Profiler::get().now_ns();
+  }
+  ~Profile_scope()
+  {
+    if (--Profiler::depth(_zone) == 0)
+      Profiler::get().record(_zone, _start, Profiler::get().now_ns());
+  }
+  Profile_scope(const Profile_scope &) = delete;
+  Profile_scope &operator=(const Profile_scope &) = delete;
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)                                                                      \
+  static const size_t PROFILER_CONCAT(_profile_zone_, __LINE__) = Profiler::get().register_zone(name); \
+  Profile_scope PROFILER_CONCAT(_profile_scope_, __LINE__)(PROFILER_CONCAT(_profile_zone_, __LINE__))
+#define PROFILE_FRAME_END() Profiler::get().end_frame()
+#define PROFILE_DRAW_HUD(renderer, x, y, color) Profiler::get().draw_hud(renderer, x, y, color)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FRAME_END()
+#define PROFILE_DRAW_HUD(renderer, x, y, color)
+
+#endif  // ENABLE_PROFILER
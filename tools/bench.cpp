@@ -0,0 +1,686 @@
+// Headless renderer benchmark
+// Renders a copy of each example scene for N frames into an Output_sink::MEMORY renderer and
+// reports ns/frame, cells/s and bytes/frame. No tty needed, so it runs in CI and under perf.
+//
+//   bench [frames] [--scene name] [--golden-write dir | --golden-check dir] [--record dir]
+//
+// --golden-write saves the last encoded frame of every scene to dir/<scene>.golden,
+// --golden-check compares against those files and exits with 1 on any mismatch.
+// --record records every scene to dir/<scene>.rec, to measure the recording overhead or feed tools/replay.
+// --check runs the correctness checks instead, comparing optimized paths against plain reference
+// implementations, and exits with 1 on any failure. --scene then picks a single check.
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../assets/library_fonts.hpp"
+#define RENDERER_IMPLEMENTATION
+#include "../renderer2D/ascii.hpp"
+#include "../Particles/particles.hpp"
+#include "../Particles/spatial_hash.hpp"
+
+struct Scene
+{
+  const char *name;
+  size_t width;
+  size_t height;
+  std::function<void(Renderer &, int)> draw;  //>> Draw frame `i`, must only depend on `i`
+  bool retained = false;                      //>> Keep the buffer between frames, see Renderer::set_retained
+};
+
+// Example 1, sum of sines
+void scene_sines(Renderer &r, int frame)
+{
+  float t = frame / 60.0f;
+  r.draw_text({1, 1}, "FPS: 60 Traget_fps: 60", utl::Color_codes::WHITE);
+  for (int x = 0; x < (int)r.get_width(); x++)
+  {
+    int y = 30 - 2 * (std::exp(std::sin((float)x / 3 + 5 * t)) + std::exp(std::sin((float)x / 4 + 0.5 * t)) +
+                      std::exp(std::sin((float)x / 3 + 9 * t)));
+    r.draw_line({x, 80}, {x, y}, ':', utl::Color_codes::BLUE);
+    r.draw_point({x, y - 1}, 'o', utl::Color_codes::RED);
+  }
+}
+
+// Example 2, tiled wall sprite
+void scene_wall(Renderer &r, int frame)
+{
+  static Sprite s("../assets/wall_sprite.txt");
+  int tex_width = 10 + frame % 5;
+  for (int i = 0; i < (int)r.get_height(); i++)
+    for (int j = 0; j < (int)r.get_width(); j++)
+      r.draw_point({j, i}, s.get_char_un(j, i, tex_width, 10), s.get_color_un(j, i, tex_width, 10));
+}
+
+// Example 4, gradients and UI elements
+void scene_gradient_ui(Renderer &r, int frame)
+{
+  static Gradient radial;
+  static auto button = std::make_shared<Button>(
+      utl::Vec<int, 2>{10, 10}, 10, 2, ':', utl::Color_codes::BLUE, utl::Color_codes::RED, "Angle++", []() {});
+  static auto slider =
+      std::make_shared<Slider>(utl::Vec<int, 2>{10, 14}, 15, '0', utl::Color_codes::BLUE, utl::Color_codes::RED, [](float) {});
+  static auto textbox =
+      std::make_shared<Textbox>(utl::Vec<int, 2>{10, 18}, 20, 5, ' ', utl::Color_codes::BLUE, utl::Color_codes::RED, "Angle (radians)");
+  if (frame == 0)
+  {
+    radial = Gradient();
+    radial.add_color_stop(0.0f, utl::Color_codes::CYAN);
+    radial.add_color_stop(1.0f, utl::Color_codes::PURPLE);
+  }
+  r.draw_button(button);
+  r.draw_slider(slider);
+  r.draw_textbox(textbox);
+  r.draw_rect_rotated_gradient({10, 30}, 80, 30, 'o', radial, frame * 0.05f);
+  r.draw_rect_radial_gradient({60, 5}, 30, 20, '#', radial);
+}
+
+// Example 5, filled circles and text
+void scene_ball(Renderer &r, int frame)
+{
+  float t = frame / 60.0f;
+  for (int i = 0; i < 8; i++)
+  {
+    int x = 60 + (int)(40 * std::cos(t + i));
+    int y = 45 + (int)(30 * std::sin(t * 1.3f + i));
+    r.draw_fill_circle({x, y}, 3 + i, 'x', utl::Color_codes::CYAN);
+  }
+  for (int i = 0; i < 8; i++) r.draw_text({0, i * 2}, "Circle: " + std::to_string(frame * i), utl::Color_codes::YELLOW);
+}
+
+// Example 6, Mandelbrot set
+void scene_mandelbrot(Renderer &r, int frame)
+{
+  int w = r.get_width(), h = r.get_height();
+  float zoom = 1.0f + frame * 0.05f;
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+    {
+      std::complex<float> c((x - w / 2.0f) * 4.0f / (w * zoom) - 0.5f, (y - h / 2.0f) * 4.0f / (h * zoom));
+      std::complex<float> z = 0;
+      int n = 0;
+      while (std::norm(z) <= 4.0f && n < 200)
+      {
+        z = z * z + c;
+        n++;
+      }
+      float t = (float)n / 200;
+      Color color = n == 200 ? Color(utl::Color_codes::BLACK) : Color::lerp(utl::Color_codes::DARK_BLUE, utl::Color_codes::LIGHT_BLUE, t);
+      r.draw_point({x, y}, '#', color);
+    }
+}
+
+// The view of scene_mandelbrot computed by Escape_time_fractal and colored through a gradient table
+void scene_fractal(Renderer &r, int frame)
+{
+  int w = r.get_width(), h = r.get_height();
+  double zoom = 1.0 + frame * 0.05;
+  static Escape_time_fractal fractal(w, h, 200);
+  static Gradient blues({{0.0f, utl::Color_codes::DARK_BLUE}, {1.0f, utl::Color_codes::LIGHT_BLUE}});
+  fractal.set_view(-0.5, 0.0, 4.0 / (w * zoom), 4.0 / (h * zoom));
+  fractal.compute();
+  r.draw_fractal(fractal, blues);
+}
+
+// A deeper view panned by a cell every frame, only the exposed column is computed
+void scene_fractal_pan(Renderer &r, int frame)
+{
+  int w = r.get_width(), h = r.get_height();
+  static Escape_time_fractal fractal(w, h, 1000);
+  static Gradient blues({{0.0f, utl::Color_codes::DARK_BLUE}, {1.0f, utl::Color_codes::LIGHT_BLUE}});
+  const double step_x = 0.002, step_y = 0.004;
+  fractal.set_view(-0.75 + frame * step_x, 0.1, step_x, step_y);
+  fractal.compute();
+  r.draw_fractal(fractal, blues);
+}
+
+// Example 7, particles
+void scene_particles(Renderer &r, int frame)
+{
+  const int count = 5000;
+  for (int i = 0; i < count; i++)
+  {
+    // Ballistic trajectory in closed form so the frame only depends on its index
+    float angle = (i * 2.399963f);
+    float speed = 10.0f + (i % 17);
+    float age = std::fmod(frame / 60.0f + i * 0.001f, 5.0f);
+    float x = 75 + speed * std::cos(angle) * age;
+    float y = 40 - speed * std::sin(angle) * age + 4.9f * age * age;
+    r.draw_point({(int)x, (int)y}, '*', Color::lerp(utl::Color_codes::RED, utl::Color_codes::BLUE, (i % 100) / 100.0f));
+  }
+}
+
+// Fountains feeding a Particle_system, a few hundred thousand particles once it fills up
+void emit_fountains(Particle_system &particles, int frame)
+{
+  const int emitted = 4000;
+  for (int i = 0; i < emitted; i++)
+  {
+    int n = frame * emitted + i;
+    float angle = -1.5708f + std::sin(n * 2.399963f) * 0.6f;
+    float speed = 20.0f + (n % 23);
+    float x = 15.0f + 40.0f * (n % 4);
+    Color color = Color::lerp(utl::Color_codes::YELLOW, utl::Color_codes::RED, (n % 50) / 50.0f);
+    particles.emit(x, 75.0f, speed * std::cos(angle) * 0.5f, speed * std::sin(angle), 1.0f + (n % 7) * 0.15f, color);
+  }
+  particles.update(1.0f / 60.0f, 0.0f, 25.0f, 0.01f);
+}
+
+// The fountains integrated as arrays and drawn with one draw_points
+void scene_particle_system(Renderer &r, int frame)
+{
+  static Particle_system particles(1 << 18);
+  emit_fountains(particles, frame);
+  r.draw_points(particles.x(), particles.y(), particles.size(), '*', particles.colors());
+}
+
+// The fountains accumulated into a Density_buffer and tone mapped
+void scene_density(Renderer &r, int frame)
+{
+  static Particle_system particles(1 << 18);
+  static Density_buffer density(r.get_width(), r.get_height());
+  static Gradient fire({{0.0f, utl::Color_codes::RED}, {0.6f, utl::Color_codes::YELLOW}, {1.0f, utl::Color_codes::WHITE}});
+  emit_fountains(particles, frame);
+  density.clear();
+  density.splat(particles.x(), particles.y(), particles.size());
+  r.draw_density(density, fire);
+}
+
+// The particles of scene_particles indexed in a Spatial_hash, cells shaded by occupancy and
+// crowded particles found with radius queries
+void scene_spatial(Renderer &r, int frame)
+{
+  const int count = 5000;
+  static std::vector<float> xs(count), ys(count);
+  static Spatial_hash grid(r.get_width(), r.get_height());
+  for (int i = 0; i < count; i++)
+  {
+    float angle = (i * 2.399963f);
+    float speed = 10.0f + (i % 17);
+    float age = std::fmod(frame / 60.0f + i * 0.001f, 5.0f);
+    xs[i] = 75 + speed * std::cos(angle) * age;
+    ys[i] = 40 - speed * std::sin(angle) * age + 4.9f * age * age;
+  }
+  grid.build(xs.data(), ys.data(), count);
+  for (size_t y = 0; y < grid.height(); y++)
+    for (size_t x = 0; x < grid.width(); x++)
+      if (uint32_t n = grid.occupancy(x, y))
+        r.draw_point({(int)x, (int)y}, char_gradient[std::min<size_t>(n, char_gradient.size()) - 1], utl::Color_codes::BLUE);
+  for (int i = 0; i < count; i += 10)
+  {
+    int neighbours = 0;
+    grid.query_radius(xs[i], ys[i], 1.5f, [&](uint32_t) { neighbours++; });
+    if (neighbours > 8)
+      r.draw_point({(int)xs[i], (int)ys[i]}, '@', utl::Color_codes::RED);
+  }
+}
+
+// Many small sprites drawn from an atlas in one batch, half of them with transparent cells, plus a plain sprite
+void scene_sprites(Renderer &r, int frame)
+{
+  static Sprite wall("../assets/wall_sprite.txt");
+  static Sprite_atlas atlas;
+  static uint32_t id = atlas.add(wall);
+  // A ring with a transparent inside and corners, every other draw
+  static uint32_t ring_id = []
+  {
+    Sprite ring(12, 6);
+    for (int y = 0; y < 6; y++)
+      for (int x = 0; x < 12; x++)
+      {
+        float dx = (x - 5.5f) / 6.0f, dy = (y - 2.5f) / 3.0f, d = dx * dx + dy * dy;
+        ring.character_data()[y * 12 + x] = d > 0.35f && d < 1.0f ? 'o' : ' ';
+        ring.color_data()[y * 12 + x] = Color(utl::Color_codes::YELLOW);
+      }
+    return atlas.add(ring, ' ');
+  }();
+  static std::vector<Sprite_draw> draws(400);
+  for (size_t i = 0; i < draws.size(); i++)
+  {
+    int x = (int)((i * 37 + frame) % (r.get_width() + 8)) - 8;
+    int y = (int)((i * 11 + frame / 2) % (r.get_height() + 6)) - 6;
+    draws[i] = {i % 2 ? ring_id : id, {x, y}, (uint32_t)(i % 4)};
+  }
+  r.draw_sprites(atlas, draws);
+  r.draw_sprite({frame % 20, 5}, wall);
+}
+
+// A rotating tiled background following a camera, a spinning sprite and pre-scaled copies
+void scene_textured(Renderer &r, int frame)
+{
+  static Sprite wall("../assets/wall_sprite.txt");
+  static Scaled_sprite_cache cache;
+  float angle = frame * 0.02f;
+  utl::Vec<float, 2> camera{frame * 0.5f, frame * 0.25f};
+  r.draw_textured_rect({0, 0},
+                       r.get_width(),
+                       r.get_height(),
+                       wall,
+                       Texture_mapping::affine({r.get_width() / 2.0f, r.get_height() / 2.0f}, camera, 1.5f, angle));
+  r.draw_sprite_transformed({40.0f, 20.0f}, wall, 0.75f + 0.25f * std::sin(frame * 0.1f), -2 * angle);
+  for (int i = 0; i < 4; i++) r.draw_sprite({4 + 28 * i, 44}, cache.get(wall, 0.5f + 0.25f * i));
+}
+
+// A 2000x2000 tile world with a transparent second layer, scrolled by a camera, one tile edited per frame
+void scene_tilemap(Renderer &r, int frame)
+{
+  static Tilemap ground(2000, 2000), trees(2000, 2000);
+  static Camera2D camera(r.get_width(), r.get_height());
+  auto make_tile = [](const char *rows, Color color)
+  {
+    Sprite tile(4, 2);
+    for (int i = 0; i < 8; i++)
+    {
+      tile.character_data()[i] = rows[i];
+      tile.color_data()[i] = color;
+    }
+    return tile;
+  };
+  static Tilemap::Tile grass = ground.add_tile(make_tile(",.,'.',.", utl::Color_codes::GREEN));
+  static Tilemap::Tile water = ground.add_tile(make_tile("~~ ~ ~~~", utl::Color_codes::BLUE));
+  static Tilemap::Tile tree = trees.add_tile(make_tile(" /\\ /||\\", utl::Color_codes::YELLOW), ' ');
+  if (frame == 0)
+  {
+    for (size_t y = 0; y < ground.height(); y++)
+      for (size_t x = 0; x < ground.width(); x++)
+      {
+        ground.set(x, y, (x * 7 + y * 3) % 23 < 4 ? water : grass);
+        trees.set(x, y, (x * 13 + y * 5) % 17 == 0 ? tree : Tilemap::empty_tile);
+      }
+    camera.set_position({0, 0});
+  }
+  camera.pan({3.0f, 1.0f});
+  ground.set(frame % 40, 10, frame % 2 ? water : grass);
+  r.draw_tilemap(ground, camera);
+  r.draw_tilemap(trees, camera);
+}
+
+// Retained mode, a static background drawn once and a ball erased and drawn again every frame
+void scene_retained(Renderer &r, int frame)
+{
+  auto ball = [](int i) { return utl::Vec<int, 2>{10 + (i * 3) % 100, 20 + (int)(12 * std::sin(i * 0.2f))}; };
+  if (frame == 0)
+    r.draw_fill_rectangle({0, 0}, r.get_width(), r.get_height(), '.', utl::Color_codes::GRAY_6);
+  else
+  {
+    utl::Vec<int, 2> previous = ball(frame - 1);
+    r.draw_fill_rectangle(previous - utl::Vec<int, 2>{5, 5}, 11, 11, '.', utl::Color_codes::GRAY_6);
+  }
+  r.draw_fill_circle(ball(frame), 5, 'o', utl::Color_codes::CYAN);
+}
+
+// Thousands of animated glyph instances advanced by one Glyph_animator
+void scene_glyphs(Renderer &r, int frame)
+{
+  static Animated_glyph clip;
+  static Glyph_animator animator;
+  if (frame == 0)
+  {
+    clip = Animated_glyph();
+    clip.load_from_file("../assets/animation.txt");
+    clip.set_frame_duration(1.0f / 12);
+    animator.clear();
+    for (uint32_t i = 0; i < 2000; i++) animator.add(&clip, -1.0f, i);
+  }
+  animator.update(1.0f / 60);
+  for (size_t i = 0; i < animator.size(); i++)
+    r.draw_glyph({(int)(i * 7 % r.get_width()), (int)(i * 3 % r.get_height())}, animator.view(i), utl::Color_codes::GREEN);
+}
+
+// Text drawn with a font
+void scene_font(Renderer &r, int frame)
+{
+  static Font font(standard_5x5_font);
+  r.draw_text_with_font({2, 2}, "SCORE " + std::to_string(frame), utl::Color_codes::GREEN, font);
+  r.draw_text_with_font({2, 12}, "HELLO WORLD", utl::Color_codes::YELLOW, font);
+}
+
+// Sums of sines plotted with sub cell dots
+void scene_dots(Renderer &r, int frame, Subcell_mode mode)
+{
+  if (frame == 0)
+    r.set_subcell_mode(mode);
+  const Subcell_canvas &canvas = r.get_canvas();
+  int w = canvas.width(), h = canvas.height();
+  float t = frame / 60.0f;
+  for (int x = 0; x < w; x++)
+    for (int k = 0; k < 3; k++)
+    {
+      float y = h / 2.0f + h / 3.0f * std::sin(x * (0.02f + 0.01f * k) + t * (1 + k));
+      r.draw_dot({x, (int)y}, k == 0 ? utl::Color_codes::RED : k == 1 ? utl::Color_codes::GREEN : utl::Color_codes::CYAN);
+    }
+  r.draw_text({1, 1}, "dots: " + std::to_string(w) + "x" + std::to_string(h), utl::Color_codes::WHITE);
+}
+
+void scene_half_block(Renderer &r, int frame) { scene_dots(r, frame, Subcell_mode::HALF_BLOCK); }
+void scene_braille(Renderer &r, int frame) { scene_dots(r, frame, Subcell_mode::BRAILLE); }
+
+std::string golden_path(const std::string &dir, const Scene &scene) { return dir + "/" + scene.name + ".golden"; }
+
+struct Check
+{
+  const char *name;
+  std::function<bool()> run;  //>> True when the optimized path matches the reference
+};
+
+// Spatial_hash::nearest against a brute force search over the indexed positions, with queries on,
+// around and far off the grid, and a default constructed hash
+bool check_nearest()
+{
+  const int count = 3000;
+  std::vector<float> xs(count), ys(count);
+  uint32_t seed = 1;
+  auto random = [&] { return (seed = seed * 1664525u + 1013904223u) / 4294967296.0f; };
+  for (int i = 0; i < count; i++)
+  {
+    xs[i] = random() * 240.0f - 20.0f;  // Some positions fall off the grid and are not indexed
+    ys[i] = random() * 80.0f - 10.0f;
+  }
+  Spatial_hash grid(50, 15, 4.0f);
+  grid.build(xs.data(), ys.data(), count);
+
+  std::vector<uint32_t> found(16);
+  for (int q = 0; q < 500; q++)
+  {
+    float x = random() * 400.0f - 100.0f, y = random() * 160.0f - 50.0f;
+    size_t k = 1 + q % 16;
+    float radius = q % 3 ? INFINITY : 10.0f;
+    std::vector<float> expected;
+    for (int i = 0; i < count; i++)
+    {
+      float dx = xs[i] - x, dy = ys[i] - y, d2 = dx * dx + dy * dy;
+      if (xs[i] >= 0.0f && xs[i] < 200.0f && ys[i] >= 0.0f && ys[i] < 60.0f && d2 <= radius * radius)
+        expected.push_back(d2);
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min(expected.size(), k));
+    size_t n = grid.nearest(x, y, k, found.data(), radius);
+    if (n != expected.size())
+      return false;
+    // Compared by distance, positions at the same distance can come in any order
+    for (size_t i = 0; i < n; i++)
+    {
+      float dx = xs[found[i]] - x, dy = ys[found[i]] - y;
+      if (dx * dx + dy * dy != expected[i])
+        return false;
+    }
+  }
+  if (grid.nearest(NAN, 1.0f, 4, found.data()) != 0 || grid.nearest(1.0f, INFINITY, 4, found.data()) != 0)
+    return false;
+
+  Spatial_hash empty;
+  empty.build(xs.data(), ys.data(), count);
+  return empty.size() == 0 && empty.nearest(1.0f, 1.0f, 4, found.data()) == 0;
+}
+
+// Atlas sprites drawn with SPRITE_FLIP_X against the same sprite with its characters reversed and
+// drawn unflipped, for odd and even widths, with and without a key, clipped on the left edge
+bool check_sprite_flip()
+{
+  for (size_t width = 1; width <= 7; width++)
+    for (int keyed = 0; keyed < 2; keyed++)
+      for (int start_x = -3; start_x <= 2; start_x++)
+      {
+        const size_t height = 2;
+        std::vector<char> chars(width * height), reversed_chars(width * height);
+        std::vector<Color> colors(width * height), reversed_colors(width * height);
+        for (size_t i = 0; i < width * height; i++)
+        {
+          chars[i] = keyed && i * 7 % 5 == 0 ? '.' : static_cast<char>('a' + i);
+          colors[i] = Color(static_cast<uint8_t>(i * 10), 0, 0);
+        }
+        for (size_t y = 0; y < height; y++)
+          for (size_t x = 0; x < width; x++)
+          {
+            reversed_chars[y * width + x] = chars[y * width + width - 1 - x];
+            reversed_colors[y * width + x] = colors[y * width + width - 1 - x];
+          }
+
+        Sprite_atlas atlas;
+        Sprite sprite(width, height, chars, colors), reversed(width, height, reversed_chars, reversed_colors);
+        uint32_t flipped_id = keyed ? atlas.add(sprite, '.') : atlas.add(sprite);
+        uint32_t reversed_id = keyed ? atlas.add(reversed, '.') : atlas.add(reversed);
+        Renderer flipped_r(6, 3, Output_sink::MEMORY), reversed_r(6, 3, Output_sink::MEMORY);
+        flipped_r.draw_sprite(atlas, flipped_id, {start_x, 0}, SPRITE_FLIP_X);
+        reversed_r.draw_sprite(atlas, reversed_id, {start_x, 0}, SPRITE_NONE);
+
+        const Buffer &a = flipped_r.get_buffer(), &b = reversed_r.get_buffer();
+        for (size_t i = 0; i < a.width * a.height; i++)
+          if (a.data[i]._ch1 != b.data[i]._ch1 || a.data[i]._ch2 != b.data[i]._ch2 || !(a.data[i]._color1 == b.data[i]._color1) ||
+              !(a.data[i]._color2 == b.data[i]._color2))
+            return false;
+      }
+  return true;
+}
+
+// The iteration of Escape_time_fractal written as a plain loop over one cell, in T like the kernel
+template <typename T>
+float reference_escape(const Escape_time_fractal &f, size_t x, size_t y, bool julia, double julia_x, double julia_y)
+{
+  const T left = static_cast<T>(f.center_x() - (f.width() / 2.0) * f.step_x());
+  T cr = left + static_cast<T>(x) * static_cast<T>(f.step_x());
+  T ci = static_cast<T>(f.center_y() + (y - f.height() / 2.0) * f.step_y());
+  T zr = 0, zi = 0;
+  if (julia)
+  {
+    zr = cr;
+    zi = ci;
+    cr = static_cast<T>(julia_x);
+    ci = static_cast<T>(julia_y);
+  }
+  else
+  {
+    T xr = cr - T(0.25), q = xr * xr + ci * ci;
+    if (q * (q + xr) <= T(0.25) * ci * ci || (cr + 1) * (cr + 1) + ci * ci <= T(0.0625))
+      return Escape_time_fractal::inside;
+  }
+  const T eps = std::numeric_limits<T>::epsilon() * 4;
+  T saved_r = zr, saved_i = zi;
+  int save_at = 8;
+  for (int n = 0; n < f.max_iterations(); n++)
+  {
+    T zr2 = zr * zr, zi2 = zi * zi;
+    if (zr2 + zi2 > static_cast<T>(Escape_time_fractal::bailout))
+    {
+      double magnitude = zr2 + zi2;
+      return static_cast<float>(std::max(0.0, n + 1.0 - std::log2(0.5 * std::log2(magnitude))));
+    }
+    zi = 2 * zr * zi + ci;
+    zr = zr2 - zi2 + cr;
+    if (std::fabs(zr - saved_r) < eps && std::fabs(zi - saved_i) < eps)
+      return Escape_time_fractal::inside;
+    if (n == save_at)
+    {
+      saved_r = zr;
+      saved_i = zi;
+      save_at *= 2;
+    }
+  }
+  return Escape_time_fractal::inside;
+}
+
+// Cells of `f` that differ from reference_escape
+size_t fractal_mismatches(const Escape_time_fractal &f, bool julia = false, double julia_x = 0, double julia_y = 0)
+{
+  size_t bad = 0;
+  for (size_t y = 0; y < f.height(); y++)
+    for (size_t x = 0; x < f.width(); x++)
+    {
+      float expected = f.uses_doubles() ? reference_escape<double>(f, x, y, julia, julia_x, julia_y)
+                                        : reference_escape<float>(f, x, y, julia, julia_x, julia_y);
+      bad += f.value(x, y) != expected;
+    }
+  return bad;
+}
+
+// The vectorized, threaded kernel against the plain loop, on a width that leaves columns for the
+// scalar tail, for a wide view in floats, a deep zoom in doubles and a Julia set
+bool check_fractal()
+{
+  Escape_time_fractal f(123, 61, 500);
+  f.set_view(-0.5, 0.0, 4.0 / 123, 4.0 / 61);
+  f.compute();
+  if (f.uses_doubles() || fractal_mismatches(f))
+    return false;
+  f.set_view(-0.743643887037151, 0.131825904205330, 2e-9, 4e-9);
+  f.compute();
+  if (!f.uses_doubles() || fractal_mismatches(f))
+    return false;
+  f.set_view(0.0, 0.0, 3.0 / 123, 3.0 / 61);
+  f.set_julia(-0.8, 0.156);
+  f.compute();
+  return fractal_mismatches(f, true, -0.8, 0.156) == 0;
+}
+
+// Panning by whole cells only computes the cells the move exposes, the other cells keep the value
+// they had before the move and the exposed ones match the plain loop
+bool check_fractal_pan()
+{
+  const size_t width = 120, height = 100, dx = 7, dy = 3;
+  const double step_x = 0.002, step_y = 0.004;
+  Escape_time_fractal f(width, height, 300);
+  f.set_view(-0.75, 0.1, step_x, step_y);
+  f.compute();
+  for (int pan = 1; pan <= 5; pan++)
+  {
+    std::vector<float> before(f.values(), f.values() + width * height);
+    size_t computed = f.cells_computed();
+    f.set_view(-0.75 + dx * pan * step_x, 0.1 + dy * pan * step_y, step_x, step_y);
+    f.compute();
+    if (f.cells_computed() - computed != width * height - (width - dx) * (height - dy))
+      return false;
+    for (size_t y = 0; y < height; y++)
+      for (size_t x = 0; x < width; x++)
+      {
+        bool kept = x + dx < width && y + dy < height;
+        float expected = kept ? before[(y + dy) * width + x + dx] : reference_escape<float>(f, x, y, false, 0, 0);
+        if (f.value(x, y) != expected)
+          return false;
+      }
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  int frames = 200;
+  std::string only;
+  std::string golden_write, golden_check, record;
+  bool check = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--scene") && i + 1 < argc)
+      only = argv[++i];
+    else if (!std::strcmp(argv[i], "--golden-write") && i + 1 < argc)
+      golden_write = argv[++i];
+    else if (!std::strcmp(argv[i], "--golden-check") && i + 1 < argc)
+      golden_check = argv[++i];
+    else if (!std::strcmp(argv[i], "--record") && i + 1 < argc)
+      record = argv[++i];
+    else if (!std::strcmp(argv[i], "--check"))
+      check = true;
+    else
+      frames = std::max(1, std::atoi(argv[i]));
+  }
+
+  if (check)
+  {
+    std::vector<Check> checks = {
+        {"nearest", check_nearest},
+        {"sprite_flip", check_sprite_flip},
+        {"fractal", check_fractal},
+        {"fractal_pan", check_fractal_pan},
+    };
+    int failures = 0;
+    for (const Check &c : checks)
+    {
+      if (!only.empty() && only != c.name)
+        continue;
+      bool ok = c.run();
+      std::printf("%-12s %s\n", c.name, ok ? "ok" : "FAIL");
+      failures += !ok;
+    }
+    return failures ? 1 : 0;
+  }
+
+  std::vector<Scene> scenes = {
+      {"sines", 120, 40, scene_sines},
+      {"wall", 40, 40, scene_wall},
+      {"gradient_ui", 100, 80, scene_gradient_ui},
+      {"ball", 120, 90, scene_ball},
+      {"mandelbrot", 60, 60, scene_mandelbrot},
+      {"fractal", 60, 60, scene_fractal},
+      {"fractal_pan", 60, 60, scene_fractal_pan},
+      {"particles", 150, 80, scene_particles},
+      {"spatial", 150, 80, scene_spatial},
+      {"particle_sys", 150, 80, scene_particle_system},
+      {"density", 150, 80, scene_density},
+      {"font", 120, 30, scene_font},
+      {"sprites", 120, 60, scene_sprites},
+      {"glyphs", 120, 60, scene_glyphs},
+      {"textured", 120, 60, scene_textured},
+      {"tilemap", 120, 60, scene_tilemap},
+      {"retained", 120, 40, scene_retained, true},
+      {"half_block", 120, 40, scene_half_block},
+      {"braille", 120, 40, scene_braille},
+  };
+
+  int failures = 0;
+  std::printf(
+      "%-12s %8s %12s %14s %12s %s\n", "scene", "frames", "ns/frame", "cells/s", "bytes/frame", golden_check.empty() ? "" : "golden");
+  for (const Scene &scene : scenes)
+  {
+    if (!only.empty() && only != scene.name)
+      continue;
+
+    Renderer r(scene.width, scene.height, Output_sink::MEMORY);
+    r.set_bg_color(utl::Color_codes::GRAY_3);
+    if (!record.empty())
+      r.start_recording(record + "/" + scene.name + ".rec");
+    r.set_retained(scene.retained);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+      if (!scene.retained)
+        r.empty();
+      scene.draw(r, i);
+      r.print();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const Window &w = r.get_window();
+    double cells = static_cast<double>(scene.width * scene.height) * frames;
+    const char *status = "";
+    if (!golden_write.empty())
+    {
+      std::ofstream file(golden_path(golden_write, scene), std::ios::binary);
+      file << w.get_last_output();
+    }
+    if (!golden_check.empty())
+    {
+      std::ifstream file(golden_path(golden_check, scene), std::ios::binary);
+      std::stringstream expected;
+      expected << file.rdbuf();
+      bool ok = file.is_open() && expected.str() == w.get_last_output();
+      status = ok ? "ok" : "MISMATCH";
+      failures += !ok;
+    }
+    std::printf("%-12s %8d %12.0f %14.0f %12.0f %s\n",
+                scene.name,
+                frames,
+                seconds * 1e9 / frames,
+                cells / seconds,
+                static_cast<double>(w.get_bytes_written()) / w.get_frames_written(),
+                status);
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+// Image to sprite conversion benchmark
+// Converts a synthetic 1920x1080 image with the per pixel path (pixelToChar + get_color) and with
+// Image::convert_image_to_sprite on one thread and on all threads, and reports ms/frame and how many
+// cells differ from the per pixel path (the fixed point luminance can round to the neighbouring glyph).
+// Also times the area averaged conversion down to a terminal sized grid and the dithering modes.
+//
+//   image_bench [iterations] [--width w] [--height h] [--cells columns rows]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../dependencies/image.hpp"
+
+// Per pixel conversion, the path convert_image_to_sprite used to take
+Sprite convert_reference(const utl::Image &image)
+{
+  size_t width = image.get_width(), height = image.get_height();
+  std::vector<char> characters(width * height);
+  std::vector<Color> colors(width * height);
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      characters[y * width + x] = image.pixelToChar(x, y);
+      colors[y * width + x] = image.get_color(x, y);
+    }
+  return Sprite(width, height, characters, colors);
+}
+
+std::vector<unsigned char> make_pixels(int width, int height, int channels)
+{
+  std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+  uint32_t seed = 12345;
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+    {
+      // Smooth gradients with some noise, so every glyph of the ramp shows up
+      seed = seed * 1664525u + 1013904223u;
+      unsigned char *p = &pixels[(static_cast<size_t>(y) * width + x) * channels];
+      p[0] = static_cast<unsigned char>((x * 255 / width + (seed >> 28)) & 0xFF);
+      p[1] = static_cast<unsigned char>(y * 255 / height);
+      p[2] = static_cast<unsigned char>(((x + y) * 127 / (width + height) + (seed >> 26)) & 0xFF);
+      if (channels == 4)
+        p[3] = static_cast<unsigned char>(seed >> 24);
+    }
+  return pixels;
+}
+
+double time_ms(int iterations, const std::function<Sprite()> &convert, Sprite &out)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) out = convert();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+double mismatch_percent(const Sprite &a, const Sprite &b)
+{
+  size_t cells = a.width() * a.height(), diff = 0;
+  for (size_t i = 0; i < cells; i++)
+    diff += a.character_data()[i] != b.character_data()[i] || a.color_data()[i] != b.color_data()[i];
+  return cells ? 100.0 * diff / cells : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 20, width = 1920, height = 1080;
+  size_t columns = 240, rows = 68;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--width") && i + 1 < argc)
+      width = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--height") && i + 1 < argc)
+      height = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--cells") && i + 2 < argc)
+    {
+      columns = std::max(1, std::atoi(argv[++i]));
+      rows = std::max(1, std::atoi(argv[++i]));
+    }
+    else
+      iterations = std::max(1, std::atoi(argv[i]));
+  }
+
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("%dx%d, %d iterations, %u threads\n", width, height, iterations, threads);
+  std::printf("%-8s %-12s %10s %10s %10s\n", "channels", "path", "ms/frame", "speedup", "mismatch");
+  for (int channels : {3, 4})
+  {
+    std::vector<unsigned char> pixels = make_pixels(width, height, channels);
+    utl::Image image(width, height, channels, pixels.data());
+
+    Sprite reference, single, parallel, area, ordered, diffused;
+    double base = time_ms(iterations, [&] { return convert_reference(image); }, reference);
+    double one = time_ms(iterations, [&] { return image.convert_image_to_sprite(1); }, single);
+    double all = time_ms(iterations, [&] { return image.convert_image_to_sprite(threads); }, parallel);
+    double averaged = time_ms(iterations, [&] { return image.convert_image_to_sprite(columns, rows, threads); }, area);
+    image.set_dither(utl::Dither_mode::ORDERED);
+    double bayer = time_ms(iterations, [&] { return image.convert_image_to_sprite(threads); }, ordered);
+    image.set_dither(utl::Dither_mode::FLOYD_STEINBERG);
+    double floyd = time_ms(iterations, [&] { return image.convert_image_to_sprite(threads); }, diffused);
+    image.set_dither(utl::Dither_mode::NONE);
+
+    std::printf("%-8d %-12s %10.3f %10s %10s\n", channels, "per pixel", base, "1.00x", "-");
+    std::printf("%-8d %-12s %10.3f %9.2fx %9.3f%%\n", channels, "1 thread", one, base / one, mismatch_percent(reference, single));
+    std::printf("%-8d %-12s %10.3f %9.2fx %9.3f%%\n", channels, "all threads", all, base / all, mismatch_percent(reference, parallel));
+    std::printf("%-8d %-12s %10.3f %9.2fx %10s\n", channels, ("area " + std::to_string(columns) + "x" + std::to_string(rows)).c_str(), averaged, base / averaged, "-");
+    std::printf("%-8d %-12s %10.3f %9.2fx %10s\n", channels, "ordered", bayer, base / bayer, "-");
+    std::printf("%-8d %-12s %10.3f %9.2fx %10s\n", channels, "floyd", floyd, base / floyd, "-");
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Replay a session recorded with Renderer::start_recording
+//
+//   replay file.rec [--max-speed] [--headless]
+//
+// Frames are presented at their recorded times unless --max-speed is given.
+// --headless presents into an Output_sink::NONE renderer (no tty needed) and implies --max-speed,
+// to measure the presentation cost of a recorded session offline.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#define RENDERER_IMPLEMENTATION
+#include "../renderer2D/ascii.hpp"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::fprintf(stderr, "Usage: %s file.rec [--max-speed] [--headless]\n", argv[0]);
+    return 1;
+  }
+  bool max_speed = false;
+  bool headless = false;
+  for (int i = 2; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--max-speed"))
+      max_speed = true;
+    else if (!std::strcmp(argv[i], "--headless"))
+      headless = max_speed = true;
+  }
+
+  Frame_player player(argv[1]);
+  if (!player.is_open())
+    return 1;
+
+  size_t frames = 0;
+  uint64_t recorded_us = 0;
+  double seconds = 0.0;
+  {
+    Renderer r(player.width(), player.height(), headless ? Output_sink::NONE : Output_sink::TERMINAL);
+    Color bg;
+    auto start = std::chrono::steady_clock::now();
+    while (player.next_frame(r.get_buffer(), bg, recorded_us))
+    {
+      if (!max_speed)
+        std::this_thread::sleep_until(start + std::chrono::microseconds(recorded_us));
+      r.set_bg_color(bg);
+      r.print();
+      frames++;
+      if (!headless)
+      {
+        Window::update_input_states();
+        if (Window::is_pressed(Keys::KEY_ESC) || Window::is_pressed(Keys::KEY_q))
+          break;
+      }
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::printf("frames: %zu\nrecorded: %.3f s\nreplayed: %.3f s\nns/frame: %.0f\n",
+              frames,
+              recorded_us / 1e6,
+              seconds,
+              frames ? seconds * 1e9 / frames : 0.0);
+  return 0;
+}
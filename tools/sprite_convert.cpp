@@ -0,0 +1,91 @@
+// Convert sprites between the text and the binary format, and time loading both
+//
+//   sprite_convert input output [--raw]   text -> binary (run length encoded unless --raw), binary -> text
+//   sprite_convert --bench input [iterations]
+//
+// --bench writes the sprite in the text, raw binary and run length encoded binary formats to
+// the temp directory and reports the load time of each.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "../dependencies/sprites.hpp"
+
+double load_ms(const std::string &path, int iterations)
+{
+  size_t cells = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+  {
+    Sprite sprite(path);
+    cells += sprite.width() * sprite.height();
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+  return cells ? ms : -1.0;
+}
+
+size_t file_size(const std::string &path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+bool same_sprite(const Sprite &a, const Sprite &b)
+{
+  size_t cells = a.width() * a.height();
+  if (a.width() != b.width() || a.height() != b.height())
+    return false;
+  return std::memcmp(a.character_data(), b.character_data(), cells) == 0 &&
+         std::equal(a.color_data(), a.color_data() + cells, b.color_data());
+}
+
+int bench(const std::string &input, int iterations)
+{
+  Sprite sprite(input);
+  if (sprite.width() * sprite.height() == 0)
+    return 1;
+
+  const std::string dir = "/tmp/";
+  const std::string text = dir + "sprite_bench.txt", raw = dir + "sprite_bench_raw.tspr", rle = dir + "sprite_bench_rle.tspr";
+  sprite.save_to_file(text);
+  sprite.save_to_binary(raw, false);
+  sprite.save_to_binary(rle, true);
+
+  std::printf("%zux%zu, %d iterations\n", sprite.width(), sprite.height(), iterations);
+  std::printf("%-8s %12s %10s %10s %s\n", "format", "bytes", "ms/load", "speedup", "identical");
+  Sprite from_text(text);
+  double base = load_ms(text, iterations);
+  for (const auto &[name, path] : {std::pair<const char *, std::string>{"text", text}, {"raw", raw}, {"rle", rle}})
+  {
+    double ms = name == std::string("text") ? base : load_ms(path, iterations);
+    std::printf("%-8s %12zu %10.3f %9.2fx %s\n", name, file_size(path), ms, base / ms, same_sprite(from_text, Sprite(path)) ? "yes" : "NO");
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc >= 3 && !std::strcmp(argv[1], "--bench"))
+    return bench(argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 20);
+  if (argc < 3)
+  {
+    std::fprintf(stderr, "usage: sprite_convert input output [--raw]\n       sprite_convert --bench input [iterations]\n");
+    return 1;
+  }
+
+  std::string input = argv[1], output = argv[2];
+  bool raw = argc > 3 && !std::strcmp(argv[3], "--raw");
+  bool binary = Sprite::is_binary_file(input);
+  Sprite sprite(input);
+  if (sprite.width() * sprite.height() == 0)
+    return 1;
+  if (binary)
+    sprite.save_to_file(output);
+  else if (!sprite.save_to_binary(output, !raw))
+    return 1;
+  std::printf("%s (%zu bytes) -> %s (%zu bytes)\n", input.c_str(), file_size(input), output.c_str(), file_size(output));
+  return 0;
+}
@@ -5,10 +5,12 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #define L_GEBRA_IMPLEMENTATION
 #include "../l_gebra/l_gebra.hpp"
+#include "../time/profiler.hpp"
 #include "keys.hpp"
 using namespace utl;
 #ifdef _WIN32
@@ -46,6 +48,18 @@ struct Mouse_event
   Mouse_event_type event;  ///< Type of the mouse event
 };
 
+/**
+ * Where Window::draw sends the encoded frames.
+ * Everything but TERMINAL is headless: the terminal is never touched, so it works without a tty (CI, perf, benchmarks).
+ */
+enum class Output_sink
+{
+  TERMINAL,  ///< Write to stdout, terminal in raw mode
+  NONE,      ///< Discard the output, only count it
+  MEMORY,    ///< Keep the last frame in memory, see Window::get_last_output()
+  FILE,      ///< Append every frame to a file
+};
+
 /**
  * Class representing a terminal window for input and output handling.
  */
@@ -64,12 +78,39 @@ private:
   struct termios orig_termios;  ///< Original terminal settings for Unix
 #endif
 
+  Output_sink _sink = Output_sink::TERMINAL;  ///< Where the frames are written
+  std::string _last_output;                   ///< Last frame, kept by the MEMORY sink
+  std::shared_ptr<std::FILE> _file;           ///< Output file of the FILE sink
+  size_t _bytes_written = 0;                  ///< Total bytes passed to draw()
+  size_t _frames_written = 0;                 ///< Number of draw() calls
+
 public:
   /**
      * Constructor to initialize the terminal.
      */
   Window() { init_terminal(); }
 
+  /**
+     * Constructor selecting the output sink, the terminal is only initialized for Output_sink::TERMINAL.
+     * @param sink Where to send the frames.
+     * @param path Output file for Output_sink::FILE.
+     */
+  Window(Output_sink sink, const std::string &path = "") : _sink(sink)
+  {
+    if (_sink == Output_sink::FILE)
+    {
+      _file = std::shared_ptr<std::FILE>(std::fopen(path.c_str(), "wb"),
+                                         [](std::FILE *f)
+                                         {
+                                           if (f)
+                                             std::fclose(f);
+                                         });
+      if (!_file)
+        std::cerr << "Error: Unable to open output file: " + path << std::endl;
+    }
+    init_terminal();
+  }
+
   /** If you'd like to tell me about your library, I'd be happy to discuss it or help with any questions you have.
      * Destructor to cleanup the terminal.
      */
@@ -80,6 +121,8 @@ public:
      */
   void init_terminal()
   {
+    if (_sink != Output_sink::TERMINAL)
+      return;
 #ifdef _WIN32
     hConsole = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE, 0, NULL, CONSOLE_TEXTMODE_BUFFER, NULL);
     SetConsoleActiveScreenBuffer(hConsole);
@@ -106,6 +149,8 @@ public:
      */
   void cleanup_terminal()
   {
+    if (_sink != Output_sink::TERMINAL)
+      return;
 #ifdef _WIN32
     CloseHandle(hConsole);
 #else
@@ -127,6 +172,23 @@ public:
      */
   void draw(const std::string &output)
   {
+    PROFILE_SCOPE("write");
+    _bytes_written += output.length();
+    _frames_written++;
+    switch (_sink)
+    {
+      case Output_sink::NONE:
+        return;
+      case Output_sink::MEMORY:
+        _last_output = output;
+        return;
+      case Output_sink::FILE:
+        if (_file)
+          std::fwrite(output.data(), 1, output.length(), _file.get());
+        return;
+      case Output_sink::TERMINAL:
+        break;
+    }
 #ifdef _WIN32
     DWORD written;
     WriteConsoleOutputCharacter(hConsole, output.c_str(), output.length(), {0, 0}, &written);
@@ -137,6 +199,45 @@ public:
 #endif
   }
 
+  /**
+     * Get the output sink.
+     * @return The sink frames are written to.
+     */
+  Output_sink get_sink() const { return _sink; }
+
+  /**
+     * Check if the window writes to something other than the terminal.
+     * @return True if the sink is headless.
+     */
+  bool is_headless() const { return _sink != Output_sink::TERMINAL; }
+
+  /**
+     * Get the last frame written, only kept by Output_sink::MEMORY.
+     * @return The last output string.
+     */
+  const std::string &get_last_output() const { return _last_output; }
+
+  /**
+     * Get the total number of bytes written by draw().
+     * @return The number of bytes.
+     */
+  size_t get_bytes_written() const { return _bytes_written; }
+
+  /**
+     * Get the number of frames written by draw().
+     * @return The number of frames.
+     */
+  size_t get_frames_written() const { return _frames_written; }
+
+  /**
+     * Reset the byte and frame counters.
+     */
+  void reset_counters()
+  {
+    _bytes_written = 0;
+    _frames_written = 0;
+  }
+
   /**
      * Parse the given key code and return the corresponding enum value.
      * @param key The key code to parse.
@@ -295,6 +396,7 @@ public:
 
   static void update_mouse_and_key_states()
   {
+    PROFILE_SCOPE("input");
 #ifdef _WIN32
     DWORD numRead;
     INPUT_RECORD inputRecord;